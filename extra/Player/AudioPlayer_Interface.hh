@@ -4,7 +4,7 @@
 
 struct AudioPlayer_Interface
 {
-    static const size_t blocksize = Volsung::AudioBuffer::blocksize;
+    static const size_t blocksize = Volsung::AudioBuffer::default_blocksize;
     virtual void initialize(unsigned) = 0;
     virtual void play(float*) = 0;
     virtual void clean_up() = 0;
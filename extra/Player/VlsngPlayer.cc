@@ -20,8 +20,10 @@ int main(const int num_args, const char* args[])
     const std::vector<std::string> arguments(args, args + num_args);
 
     std::string filename;
+    std::string cpp_filename;
     float time_seconds = 5.f;
     size_t num_channels = 1;
+    size_t blocksize = AudioPlayer::blocksize;
 
     std::map<std::string, float> parameters;
     bool offline = false;
@@ -48,9 +50,11 @@ int main(const int num_args, const char* args[])
             }
             else if (arg == "-t" || arg == "--time") time_seconds = std::stof(next_arg());
             else if (arg == "-c" || arg == "--channels") num_channels = std::stoi(next_arg());
+            else if (arg == "-b" || arg == "--blocksize") blocksize = std::stoi(next_arg());
             else if (arg == "-o" || arg == "--offline") { offline = true; continue; }
             else if (arg == "-n" || arg == "--compile") { dont_run = true; continue; }
             else if (               arg == "--profile") { profile = true; continue; }
+            else if (arg == "-e" || arg == "--emit-cpp") cpp_filename = next_arg();
             else if (arg == "-p" || arg == "--parameter") {
                 const std::string& key_value = next_arg();
                 const size_t pos = key_value.find("=");
@@ -95,6 +99,20 @@ int main(const int num_args, const char* args[])
         parser.source_code = buffer.str();
     }
 
+    // The audio devices are fed blocks of a fixed size, so other sizes are only for offline runs
+    // and exported programs
+    if (!offline && cpp_filename.empty() && blocksize != AudioPlayer::blocksize) {
+        std::cout << "Block size can only be changed for offline runs. Using " << AudioPlayer::blocksize << "." << std::endl;
+        blocksize = AudioPlayer::blocksize;
+    }
+
+    try {
+        program.set_blocksize(blocksize);
+    }
+    catch (const Volsung::VolsungException&) {
+        std::exit(1);
+    }
+
     program.configure_io(0, num_channels);
     program.reset();
     for (auto& [key, value] : parameters) {
@@ -104,10 +122,21 @@ int main(const int num_args, const char* args[])
     if (!parser.parse_program(program)) std::exit(0);
     if (dont_run) std::exit(0);
 
+    if (!cpp_filename.empty()) {
+        try {
+            const std::string code = program.emit_cpp();
+            std::ofstream(cpp_filename) << code;
+        }
+        catch (const Volsung::VolsungException&) {
+            std::exit(1);
+        }
+        std::exit(0);
+    }
+
     AudioPlayer player;
     player.initialize((Volsung::uint) num_channels);
 
-    float* data = new float[Volsung::AudioBuffer::blocksize];
+    float* data = new float[blocksize];
 
     auto const play_one_block = [&] () {
         Volsung::MultichannelBuffer buffer = program.run({ Volsung::AudioBuffer::zero });
@@ -121,7 +150,7 @@ int main(const int num_args, const char* args[])
     }
 
     else {
-        const auto blocks_to_generate = Volsung::get_sample_rate() / AudioPlayer::blocksize * time_seconds;
+        const auto blocks_to_generate = Volsung::get_sample_rate() / blocksize * time_seconds;
         for (size_t n = 0; n < blocks_to_generate; n++)
             play_one_block();
     }
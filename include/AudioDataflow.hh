@@ -3,45 +3,86 @@
 
 #include <memory>
 #include <vector>
-#include <array>
 
 namespace Volsung {
 
 class AudioBuffer
 {
 public:
-    const static inline size_t blocksize = 64;
-    using Block = std::array<float, blocksize>;
-    
+    // Programs process blocks of up to `max_blocksize` samples, `default_blocksize` unless set
+    const static inline size_t default_blocksize = 64;
+    const static inline size_t max_blocksize = 4096;
+
     const static AudioBuffer zero;
  
     __attribute__((always_inline))
     inline float& operator[](size_t n)
     {
-        return (*data)[n];
+        return data[n];
     }
 
     __attribute__((always_inline))
     inline float operator[](size_t n) const
     {
-        return (*data)[n];
+        return data[n];
     }
 
     float* data_pointer();
+    const float* data_pointer() const;
+    size_t size() const;
+
+    // A buffer referring to part of this one's samples, without taking ownership of them
+    AudioBuffer view(const size_t, const size_t) const;
+
     AudioBuffer();
+    explicit AudioBuffer(const size_t);
+    AudioBuffer(float* const, const size_t);
 
-    auto begin() { return std::begin(*data); }
-    auto end() { return std::end(*data); }
+    auto begin() { return data; }
+    auto end() { return data + length; }
 
 private:
-    std::shared_ptr<Block> data = nullptr;
+    std::shared_ptr<std::vector<float>> storage = nullptr;
+    float* data = nullptr;
+    size_t length = default_blocksize;
 };
 using MultichannelBuffer = std::vector<AudioBuffer>;
-using Block = AudioBuffer::Block;
+
+// Sample storage for the buffers of a compiled program, allocated in one piece and handed out
+// in slots of a block each. Slots start on a cache line.
+class BufferArena
+{
+    struct alignas(64) Line
+    {
+        float samples[16];
+    };
+    std::vector<Line> lines;
+    size_t lines_per_slot = 0;
+
+public:
+    void allocate(const size_t, const size_t);
+    AudioBuffer slot(const size_t, const size_t);
+    size_t size() const;
+};
 
 struct AudioConnector
 {
     AudioBuffer stored_buffer;
+
+    // Connections closing a feedback loop read the samples written `delay` samples earlier,
+    // wrapping around at the end of the block, which is `period` samples long
+    size_t delay = 0;
+    size_t period = 0;
+
+    // Connections read late from earlier in the schedule keep the last `delay` samples of the
+    // block before, taken as the loop reaches the end of the block, in two halves used in turn
+    std::vector<float> history;
+    size_t history_half = 0;
+
+    // Applied while summing into the input, folded in from a constant multiplication after it
+    float gain = 1.f;
+
+    AudioBuffer read(const size_t, const size_t);
 };
 
 class CircularBuffer
@@ -54,6 +95,7 @@ public:
     float operator[](long) const;
     void resize_stream(const size_t);
     void increment_pointer();
+    size_t size() const;
 
     CircularBuffer() = default;
     CircularBuffer(const size_t);
@@ -65,15 +107,19 @@ struct AudioInput
 {
     std::vector<std::shared_ptr<AudioConnector>> connections;
 
+    // Where the connections are summed, when there are several or they are scaled
+    AudioBuffer mix;
+
     bool is_connected() const;
-    const AudioBuffer read_buffer() const;
+    bool is_mixed() const;
+    const AudioBuffer read_buffer(const size_t, const size_t);
 };
 
 struct AudioOutput
 {
     std::vector<std::shared_ptr<AudioConnector>> connections;
 
-    void write_buffer(const AudioBuffer);
+    void bind(const AudioBuffer);
     void connect(AudioInput&);
 };
 
@@ -4,9 +4,12 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <optional>
+#include <memory>
 
 #include "VolsungCore.hh"
 #include "AudioDataflow.hh"
+#include "Kernels.hh"
 
 namespace Volsung {
 
@@ -27,6 +30,7 @@ public:
 
     // GateListener(const uint _input): input(_input) { }
     GateState read_gate_state(float next_value);
+    float get_last_value() const;
 };
 
 using GateState = GateListener::GateState;
@@ -35,11 +39,42 @@ bool operator& (GateState, GateState);
 GateState operator| (GateState, GateState);
 
 
+// The C++ an object is exported as. In the code, `$in<k>` and `$out<k>` stand for the sample of
+// the k-th input and output, `$i` for the index of the sample in the block and `$n` for the
+// length of the block. Any other name starting with `$` is made unique to the object, and those
+// declared in `state` keep their value from one block to the next. Code run at the start of the
+// block can't read the inputs.
+struct ObjectCode
+{
+    // State with a length is an array of that many elements, initialised with a braced list
+    struct Variable
+    {
+        std::string type;
+        std::string name;
+        std::string value;
+        size_t length = 0;
+    };
+
+    std::vector<Variable> state;
+    std::string block_start;
+    std::string sample;
+    std::string block_end;
+
+    // Functions of the exported file used by the code, such as `sin_turns`
+    std::vector<std::string> helpers;
+};
+
 class TypedValue;
+class ObjectGroup;
 class AudioObject
 {
 private:
-    MultichannelBuffer in, out;
+    friend class ObjectGroup;
+    MultichannelBuffer in, out, out_views;
+    size_t current_blocksize = AudioBuffer::default_blocksize;
+    bool in_place = false;
+    bool passes_through = false;
+    bool fast_math = false;
 
     struct LinkedValue
     {
@@ -48,6 +83,11 @@ private:
         const uint input;
     };
     std::vector<LinkedValue> linked_values;
+    std::vector<LinkedValue> modulated_values;
+
+    // Reading the inputs of a block, and writing back outputs handed back in other buffers
+    void begin_block(const size_t, const size_t);
+    void end_block(const size_t, const size_t);
 
 protected:
     virtual void process(const MultichannelBuffer&, MultichannelBuffer&) = 0;
@@ -58,6 +98,46 @@ protected:
     void add_gate_listener(bool* const, const size_t);
     void update_parameters(size_t);
 
+    __attribute__((always_inline))
+    inline bool uses_fast_math() const
+    {
+        return fast_math;
+    }
+
+    __attribute__((always_inline))
+    inline bool parameters_are_constant() const
+    {
+        return modulated_values.empty();
+    }
+
+    // Runs `kernel` on each sample of the block, updating the linked parameters in between
+    // only if one of their inputs is connected
+    template <typename Kernel>
+    void process_samples(const Kernel& kernel)
+    {
+        if (parameters_are_constant()) {
+            for (size_t n = 0; n < blocksize(); n++) kernel(n);
+            return;
+        }
+
+        for (size_t n = 0; n < blocksize(); n++) {
+            update_parameters(n);
+            kernel(n);
+        }
+    }
+    void enable_in_place_processing();
+
+    __attribute__((always_inline))
+    inline size_t blocksize() const
+    {
+        return current_blocksize;
+    }
+
+    // For exporting: a linked parameter, read from its input when that is connected, and code
+    // setting `$opened` when the gate at the given input opens, keeping its last value in `$gate`
+    std::string parameter_code(const uint, const float) const;
+    static std::string gate_code(const std::string&);
+
 
 public:
     __attribute__((always_inline))
@@ -66,14 +146,104 @@ public:
         return inputs.at(input_index).is_connected();
     }
 
-    void implement();
-        
+    virtual void implement(const size_t, const size_t);
+    void bind_output(const size_t, const AudioBuffer);
+
+    // Binds the object to whole blocks of its buffers, after which run_block() processes a block
+    // without reading the inputs through their connections. Inputs summing several connections,
+    // or scaling one, are expected to be summed into their mix buffer beforehand.
+    void bind_block(const size_t);
+    void run_block();
+
+    // Objects computing each output sample only from the input samples at the same index
+    // may write their first output over their first input, when nothing else reads it later
+    bool can_process_in_place() const;
+
+    // Objects that only scale their first input by a constant report the factor, so that it
+    // can be folded into the sum of the input. Once it is, the object passes its input through.
+    virtual std::optional<float> constant_gain() const;
+    void pass_through(const bool);
+    bool is_passing_through() const;
+
+    // Objects processing in place are stateless, so with constant inputs their output is constant
+    // too, and can be worked out once when the program is compiled
+    virtual bool is_pure() const;
+
+    // Pure objects working out each sample from the same sample of their first input, and of their
+    // second input when it is connected, describe the operation, so that chains of them can be
+    // run as one kernel
+    virtual std::optional<ElementwiseOperation> elementwise_operation() const;
+
+    // Objects that can be exported to C++ give the code they are exported as. Element-wise
+    // objects are exported from their operation.
+    virtual std::optional<ObjectCode> generate_code() const;
+
+    // C++ literals reading back as exactly the given number
+    static std::string literal(const float);
+    static std::string literal(const double);
+
+    // Objects that, with their parameters as they are, hand their first input on unchanged
+    virtual bool is_identity() const;
+
+    // Objects affecting anything besides their outputs are always run, as is everything feeding
+    // them. Objects that reach neither one of these nor the output of the program are not run.
+    virtual bool has_side_effects() const;
+
+    // Lets maths objects use approximations, trading a little accuracy for speed
+    void use_fast_math(const bool);
+
     std::vector<AudioInput>  inputs;
     std::vector<AudioOutput> outputs;
     AudioObject() = default;
 
     virtual void finish();
     virtual ~AudioObject() = default;
+
+    // Objects that delay their input report the delay here, so that feedback loops through
+    // them can be run in sub-blocks no longer than it, and absorb the latency of the loop
+    virtual size_t feedback_delay() const;
+    virtual void compensate_feedback_latency(const size_t);
+
+    // Objects that can be run several at a time make the group that runs them. The members of a
+    // group are only run by it, and are left in place to be connected to.
+    virtual std::unique_ptr<ObjectGroup> make_group() const;
+};
+
+// Runs several objects as one, keeping their state side by side so that each instruction can
+// process several of them at once
+class ObjectGroup : public AudioObject
+{
+    std::vector<AudioObject*> members;
+
+    // Run once the members have been bound to their buffers
+    void process(const MultichannelBuffer&, MultichannelBuffer&) override;
+
+protected:
+    virtual void add(AudioObject* const) = 0;
+    virtual void process_members(const std::vector<AudioObject*>&, const size_t) = 0;
+
+    static const float* input_of(const AudioObject* const, const size_t);
+    static float* output_of(AudioObject* const, const size_t);
+
+public:
+    virtual bool accepts(const AudioObject* const) const = 0;
+    void add_member(AudioObject* const);
+    const std::vector<AudioObject*>& get_members() const;
+
+    void implement(const size_t, const size_t) override;
+};
+
+// Runs a chain of element-wise objects, each feeding only the first input of the next, as a
+// single kernel. Only the output of the last member is written.
+class ElementwiseChain : public ObjectGroup
+{
+    std::vector<ElementwiseOperation> operations;
+
+    void add(AudioObject* const) override;
+    void process_members(const std::vector<AudioObject*>&, const size_t) override;
+
+public:
+    bool accepts(const AudioObject* const) const override;
 };
 
 }
@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "FFT.hh"
+
+namespace Volsung {
+
+// Convolves a signal with a fixed impulse response, without adding latency. Short impulse
+// responses are convolved directly. Longer ones are split into equal partitions: the first is
+// convolved directly, and the rest in the frequency domain, one partition's worth of samples
+// ahead of when they are needed (uniformly partitioned overlap-save).
+class Convolution
+{
+    class DirectForm
+    {
+        std::vector<float> reversed_taps;
+        std::vector<float> history;
+        size_t position = 0;
+
+    public:
+        float process(const float);
+        DirectForm(const float* const, const size_t);
+    };
+
+    DirectForm head;
+
+    size_t partition_size = 0;
+    std::unique_ptr<RealFFT> fft;
+    std::vector<std::vector<Complex>> partitions;
+    std::vector<std::vector<Complex>> input_spectra;
+    size_t newest_spectrum = 0;
+
+    std::vector<float> input_blocks;
+    std::vector<float> output_block;
+    std::vector<float> tail;
+    std::vector<Complex> scratch;
+    size_t block_position = 0;
+
+    void calculate_tail();
+
+public:
+    static constexpr size_t fft_threshold = 128;
+
+    void process(const float* const, float* const, const size_t);
+    Convolution(const std::vector<float>&);
+};
+
+}
@@ -0,0 +1,60 @@
+
+#pragma once
+
+#include <functional>
+
+#include "SyntaxTree.hh"
+
+namespace Volsung {
+
+// The arguments of a function call, which the body of the function sees as its symbols, along
+// with the constants. A backtick in the body looks in the frame of the function it was declared
+// in, or in the program once there are no more. Functions declared in a body keep a copy of the
+// frames, owning the arguments, as they can be called after it returns.
+struct CallFrame
+{
+    const std::vector<Symbol>* parameters;
+    const ArgumentList* arguments;
+    std::shared_ptr<const CallFrame> enclosing;
+    ArgumentList captured_arguments;
+};
+
+// Runs a syntax tree on a program. Statements are run in order, declaring symbols, subgraphs and
+// objects, and connecting the objects, and their expressions are evaluated when they're reached.
+// The members of a group evaluate the same arguments, and subgraphs run their body each time
+// they're made. Functions run their body on a frame of their arguments, on the stack.
+class Evaluator
+{
+    Graph* program = nullptr;
+    const CallFrame* frame = nullptr;
+    size_t line = 0;
+    std::function<void()> hook;
+
+    // Keeps the syntax tree alive, for as long as the functions and subgraphs declared in it are
+    std::shared_ptr<const void> syntax_tree;
+
+    void error(const std::string&) const;
+
+    void evaluate(const Statement&);
+    TypedValue evaluate(const Expression&);
+    ArgumentList evaluate(const std::vector<std::unique_ptr<Expression>>&);
+
+    TypedValue find_symbol(const Expression&);
+    TypedValue make_function(const Expression&);
+    TypedValue call(const Expression&, const TypedValue&, const ArgumentList&);
+
+    void connect(const Statement&);
+    ObjectRange find_object(const ObjectReference&);
+    ObjectRange declare_object(const ObjectDeclaration&);
+    ObjectRange make_object(const std::string&, const Symbol, const ArgumentList&);
+
+public:
+    // Runs the statements on the program, then compiles it. If a statement fails, the program is
+    // reset and false is returned.
+    bool run(Graph&, const std::shared_ptr<const Block>&);
+
+    // Sets a function to call after each statement is run
+    void set_hook(std::function<void()>);
+};
+
+}
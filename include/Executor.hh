@@ -0,0 +1,47 @@
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <exception>
+
+namespace Volsung {
+
+class WorkerPool;
+
+// A fixed graph of tasks, run over and over. Each run, every task runs once, after the tasks
+// it depends on. Tasks are run by a pool of worker threads shared by every graph, with the
+// calling thread helping out. A finished task decrements the dependency counters of its
+// successors, and runs those that become ready on the same thread; idle threads steal them.
+// Anything run from inside a task, such as the program of a subgraph, runs on that thread.
+class TaskGraph
+{
+public:
+    using Callback = std::function<void(const size_t)>;
+
+    // Tasks must be numbered so that every task comes after the ones it depends on
+    TaskGraph(const std::vector<std::vector<size_t>>&, const Callback);
+
+    // Runs every task once, on up to the given number of threads, and returns when all have run
+    void run(const size_t);
+
+    static bool is_inside_task();
+
+private:
+    friend class WorkerPool;
+    void execute(const size_t);
+
+    std::vector<std::vector<size_t>> successors;
+    std::vector<size_t> dependency_counts;
+    std::unique_ptr<std::atomic<size_t>[]> pending;
+    std::atomic<size_t> remaining { 0 };
+    const Callback callback;
+
+    std::mutex failure_mutex;
+    std::exception_ptr failure;
+};
+
+}
@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include <complex>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace Volsung {
+
+using Complex = std::complex<float>;
+
+// Complex FFT of a fixed size. Powers of two are transformed in place, with radix-4 passes
+// (and a radix-2 pass first when the size is an odd power of two) over twiddle factors worked
+// out once up front. Other sizes go through Bluestein's algorithm, which turns the transform
+// into a convolution done with a power of two FFT. Inverse transforms aren't normalised.
+class FFT
+{
+    size_t size;
+    std::vector<std::uint32_t> bit_reversal;
+    std::vector<Complex> twiddles;
+
+    std::shared_ptr<const FFT> bluestein_plan;
+    std::vector<Complex> chirp;
+    std::vector<Complex> chirp_spectrum;
+
+    template <bool inverse>
+    void transform(Complex* const) const;
+    void transform_bluestein(Complex* const) const;
+
+public:
+    // Plans are shared, and kept for the lifetime of the program once made. The same goes for
+    // RealFFT::plan
+    static std::shared_ptr<const FFT> plan(const size_t);
+
+    explicit FFT(const size_t);
+
+    void forward(Complex* const) const;
+    void inverse(Complex* const) const;
+    size_t get_size() const;
+};
+
+// FFT of a real signal of even size, done as a complex FFT of half the size. Spectra are
+// represented by their first size / 2 + 1 bins, the rest being their complex conjugates.
+class RealFFT
+{
+    size_t size;
+    std::shared_ptr<const FFT> half;
+    std::vector<Complex> twiddles;
+
+public:
+    static std::shared_ptr<const RealFFT> plan(const size_t);
+
+    explicit RealFFT(const size_t);
+
+    void forward(const float* const, Complex* const) const;
+
+    // Overwrites the spectrum it is given
+    void inverse(Complex* const, float* const) const;
+    size_t get_size() const;
+};
+
+}
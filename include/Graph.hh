@@ -8,9 +8,11 @@
 #include <random>
 #include <chrono>
 #include <array>
+#include <set>
 
 #include "VolsungCore.hh"
 #include "AudioDataflow.hh"
+#include "Executor.hh"
 
 namespace Volsung {
 
@@ -46,7 +48,9 @@ class TypedValue;
 class Text;
 class Sequence;
 class AudioObject;
+class ObjectGroup;
 class Program;
+struct CodeEmitter;
 
 class Number
 {
@@ -84,52 +88,66 @@ public:
     Number exponentiate_num(const Number&) const;
 };
 
+// Text and sequences share their contents between copies, which are never changed in place.
+// Copying them, to read a symbol or pass an argument, takes the same time however long they are.
 class Text
 {
-    std::string value;
+    std::shared_ptr<const std::string> value;
 public:
-    void operator=(std::string string) { value = string; }
+    void operator=(std::string string) { value = std::make_shared<const std::string>(std::move(string)); }
     Text& operator+(const Text& rhs) {
-        value = value + rhs.value;
+        value = std::make_shared<const std::string>(*value + *rhs.value);
         return *this;
     }
 
     operator std::string() const {
-        return value;
+        return *value;
     }
 
-    Text(std::string string) : value(string) {}
-    Text() = default;
+    Text(std::string string) : value(std::make_shared<const std::string>(std::move(string))) {}
+    Text() : Text(std::string()) {}
 };
 
+// The elements of a sequence are kept as an array of their real parts, and, once any of them
+// has an imaginary part, an array of those alongside. Real sequences, which most are, take half
+// the memory, and their arithmetic and maths run on the kernels a vector at a time. A sequence
+// that shares its elements copies them before it changes them.
 class Sequence
 {
-    // const size_t identifier;
-    // static inline std::vector<std::vector<Number>> sequence_table;
-    // std::vector<Number>* data;
-    std::vector<Number> data;
+    struct Elements
+    {
+        std::vector<float> reals;
+        std::vector<float> imags;
+    };
+    std::shared_ptr<Elements> elements;
+
+    Elements& unique_elements();
 
 public:
-    Number* get_data_pointer();
     size_t size() const;
+    bool is_complex() const;
     operator Text() const;
     void add_element(const Number);
+    void reserve(const size_t);
     void perform_range_check(const long long) const;
 
-    Number& operator[](long long);
-    const Number& operator[](long long) const;
+    const Number operator[](long long) const;
+    void set(long long, const Number);
+
+    // The real parts, and the imaginary parts, which are null for real sequences
+    float* real_data();
+    const float* real_data() const;
+    const float* imag_data() const;
 
     TypedValue add(const TypedValue&);
     TypedValue subtract(const TypedValue&);
     TypedValue multiply(const TypedValue&);
     TypedValue divide(const TypedValue&);
     TypedValue exponentiate(const TypedValue&);
+    void negate();
 
-    auto begin() { return std::begin(data); }
-    auto end() { return std::end(data); }
-
-    Sequence() = default;
-    Sequence(const std::vector<float>&);
+    Sequence();
+    Sequence(std::vector<float>, std::vector<float> = { });
 };
 
 using ArgumentList = std::vector<TypedValue>;
@@ -143,14 +161,20 @@ public:
     size_t max_arguments;
     bool can_be_mapped;
 
+    // Procedures mapped over sequences can map a real sequence all at once, given whether to
+    // use fast maths, rather than being called on each element
+    using SequenceKernel = void (*)(float* const, const float* const, const size_t, const bool);
+    SequenceKernel sequence_kernel;
+
     TypedValue operator()(const ArgumentList&, Program*) const;
-    Procedure(Implementation, size_t, size_t, bool = false);
+    Procedure(Implementation, size_t, size_t, bool = false, SequenceKernel = nullptr);
 
     Procedure& operator=(const Procedure& proc) = default;
 
     Procedure(const Procedure& proc) : min_arguments(proc.min_arguments),
                                        max_arguments(proc.max_arguments),
-                                       can_be_mapped(proc.can_be_mapped) {
+                                       can_be_mapped(proc.can_be_mapped),
+                                       sequence_kernel(proc.sequence_kernel) {
         implementation = proc.implementation;
     }
 };
@@ -200,12 +224,36 @@ inline std::string type_debug_name<Procedure>() { return "Procedure"; }
 
 using DirectiveFunctor        = std::function<void(const ArgumentList&, Program* const)>;
 using AudioProcessingCallback = std::function<void(const MultichannelBuffer&, MultichannelBuffer&, std::any)>;
-using SubgraphRepresentation  = std::pair<const std::string, const std::array<float, 2>>;
+
+struct Statement;
+
+// A subgraph declaration, and its number of inputs and outputs. The body of the declaration is
+// parsed once, and shared by the syntax tree and every subgraph made from it.
+struct SubgraphRepresentation
+{
+    std::shared_ptr<const Statement> declaration;
+    std::array<float, 2> io;
+
+    // The statements in the body, which keep the rest of the syntax tree alive too
+    std::shared_ptr<const std::vector<Statement>> body() const;
+};
 
 template <class T>
 using SymbolTable = std::map<std::string, T>;
 using Frame = std::vector<float>;
 
+// An object of a program, or the members of a group, which take up a range of its objects. A
+// member of a group is a range of one, keeping the name of the group.
+struct ObjectRange
+{
+    Symbol name;
+    size_t first;
+    size_t size;
+    bool group;
+
+    ObjectRange member(const size_t n) const { return { name, first + n, 1, false }; }
+};
+
 
 
 class Program
@@ -214,27 +262,117 @@ class Program
 
     uint inputs = 0;
     uint outputs = 0;
-    SymbolTable<std::unique_ptr<AudioObject>> table;
-    SymbolTable<TypedValue> symbol_table;
     MultichannelBuffer out;
 
+    // Objects are kept in the order they're made, and named ones are found through `object_ids`.
+    // The members of a group are made one after the other, so a group is a range of `objects`.
+    std::vector<std::unique_ptr<AudioObject>> objects;
+    std::unordered_map<Symbol, size_t> object_ids;
+    std::vector<ObjectRange> groups;
+    std::unordered_map<Symbol, size_t> group_ids;
+    std::unordered_map<size_t, std::string> origins;    // The type and line of unnamed objects, by index
+    std::unordered_map<Symbol, TypedValue> symbol_table;
+
+    void check_name_is_free(const Symbol) const;
+    std::string describe(const ObjectRange&) const;
+    std::string name_of(const AudioObject*) const;
+
+    struct Segment
+    {
+        // The objects in a segment take up [first, last) in the schedule, and are run
+        // alternately, `subblock_length` samples at a time
+        size_t first;
+        size_t last;
+        size_t subblock_length;
+
+        // The delays in a feedback loop whose outputs are read a sub-block late, having taken
+        // the sub-block off their delay
+        std::vector<AudioObject*> delays;
+
+        // Steps run a whole block at a time are lowered to [first, last) of the instructions
+        bool lowered = false;
+        size_t first_instruction = 0;
+        size_t last_instruction = 0;
+    };
+
+    // Either sums the sources into the mix buffer of an input, or, given an object or a group, runs
+    // it on the buffers it was bound to. Feedback loops read their connections at an offset into the
+    // block, so they are run through AudioObject::implement() instead.
+    struct Instruction
+    {
+        AudioObject* object;
+        float* mix;
+        std::vector<std::pair<const float*, float>> sources;
+    };
+    std::vector<Instruction> instructions;
+    void lower_steps();
+
+    std::vector<AudioObject*> schedule;
+    std::vector<Segment> feedback_loops;
+
+    // Members of a group of objects, declared with `[N]`, that don't feed each other are run
+    // side by side by an object group, which takes their place in the schedule. Chains of
+    // element-wise objects are fused into a group the same way.
+    std::vector<std::unique_ptr<ObjectGroup>> object_groups;
+    void form_object_groups(std::map<AudioObject*, std::vector<AudioObject*>>&, const std::set<AudioObject*>&);
+    std::vector<AudioObject*> objects_at(const size_t) const;
+
+    bool schedule_is_stale = true;
+    size_t blocksize = AudioBuffer::default_blocksize;
+    BufferArena arena;
+    bool fast_math = false;
+
+    // Every feedback loop is a step, and so is every other object on its own, with the whole
+    // block as its sub-block. When the steps are run on several threads, `tasks` says which
+    // steps have to wait for which, and `task_threads` how many threads, worked out on compiling.
+    std::vector<Segment> steps;
+    std::unique_ptr<TaskGraph> tasks;
+    size_t task_threads = 1;
+    size_t threads = 1;
+    static constexpr size_t min_parallel_steps = 8;
+
+    std::set<AudioObject*> evaluate_constant_objects(const std::unordered_map<AudioConnector*, AudioObject*>&);
+    void allocate_buffers(const std::unordered_map<AudioConnector*, AudioObject*>&, const std::map<AudioObject*, size_t>&, const bool);
+    void plan_tasks(const std::unordered_map<AudioConnector*, AudioObject*>&, const std::map<AudioObject*, size_t>&);
+    void run_step(const Segment&);
+
+    // Writes the code of the program into the emitter, given the expressions of its inputs,
+    // and gives back those of its outputs
+    void emit_code(CodeEmitter&, const std::vector<std::string>&, std::vector<std::string>&);
+
 public:
     static const SymbolTable<Procedure> procedures;
 
-    SymbolTable<const size_t> group_sizes;
-    SymbolTable<const SubgraphRepresentation> subgraphs;
+    std::unordered_map<Symbol, const SubgraphRepresentation> subgraphs;
     Program* parent = nullptr;
 
+    // Objects made without a name are left `unnamed`, and can only be reached through the
+    // range they're made as
     template<typename>
-    void create_object(const std::string&, const ArgumentList&);
+    ObjectRange create_object(const Symbol, const ArgumentList&);
+
+    template<typename Object>
+    void create_object(const std::string& name, const ArgumentList& arguments) { create_object<Object>(intern(name), arguments); }
+
+    // Records where an unnamed object or group was declared, so errors can point to it
+    void set_origin(const ObjectRange&, const std::string&, const size_t);
+
+    // Makes the objects made since the first of them, in order, the members of a group
+    ObjectRange create_group(const Symbol, const size_t);
+    size_t object_count() const;
+
+    // The object of that name, or the members of the group, erroring if there's neither
+    ObjectRange find_object(const Symbol) const;
 
     template<typename T>
-    T* get_audio_object_raw_pointer(const std::string&) const;
+    T* get_audio_object_raw_pointer(const ObjectRange&) const;
 
-    void check_io_and_connect_objects(const std::string&, const uint,
-                                      const std::string&, const uint);
+    template<typename T>
+    T* get_audio_object_raw_pointer(const std::string& name) const { return get_audio_object_raw_pointer<T>(find_object(intern(name))); }
 
+    void check_io_and_connect_objects(AudioObject* const, const uint, AudioObject* const, const uint);
 
+    void connect_objects(const ObjectRange&, const uint, const ObjectRange&, const uint, const ConnectionType = ConnectionType::one_to_one);
     void connect_objects(const std::string&, const uint, const std::string&, const uint, const ConnectionType = ConnectionType::one_to_one);
 
     static void add_directive(const std::string&, const DirectiveFunctor);
@@ -244,21 +382,49 @@ public:
 
     void configure_io(const uint, const uint);
 
+    // The number of samples made by each run. Set it before parsing the program, which then sees
+    // it as the `blocksize` symbol. Feedback loops are run in sub-blocks dividing it, so their
+    // latency depends on it too. Subgraphs start out with the block size of their parent.
+    void set_blocksize(const size_t);
+    size_t get_blocksize() const;
+
+    // Fast maths is used when the program defines `fast_math` as true, or failing that, when
+    // it is set here, or it is used by the program containing this one
+    void set_fast_math(const bool);
+    bool uses_fast_math() const;
+
+    // Steps of the program that don't depend on each other are run on up to this many threads,
+    // when the program defines `threads`, or failing that, when it is set here, or it is used by
+    // the program containing this one. Small or mostly serial programs run on one thread anyway.
+    void set_thread_count(const size_t);
+    size_t thread_count() const;
+
+    void compile();
     void simulate();
     MultichannelBuffer run();
-    MultichannelBuffer run(const MultichannelBuffer);
+    MultichannelBuffer run(const MultichannelBuffer&);
+    MultichannelBuffer run(const MultichannelBuffer&, const size_t);
 
+    // The program, compiled as it is, as a C++ file with a `process(float** in, float** out, int n)`
+    // function running it. Objects, subgraphs and constants are written in where they are used,
+    // and the state of the objects is carried over. Fails for objects that can't be exported.
+    std::string emit_cpp();
+
+    // Whether any object of the program affects anything besides the output of the program
+    bool has_side_effects() const;
+
+    bool object_exists(const Symbol) const;
     bool object_exists(const std::string&) const;
-    void expect_to_be_object(const std::string&) const;
-    void expect_to_be_group(const std::string&) const;
+    void expect_to_be_object(const ObjectRange&) const;
+    void expect_to_be_group(const ObjectRange&) const;
 
     void finish();
     void reset();
 
-    const SubgraphRepresentation find_subgraph_recursively(std::string);
+    const SubgraphRepresentation& find_subgraph_recursively(const Symbol) const;
 
-    auto begin() { return std::begin(table); }
-    auto end() { return std::end(table); }
+    auto begin() { return std::begin(objects); }
+    auto end() { return std::end(objects); }
 
     template<class>
     bool symbol_is_type(const std::string&) const;
@@ -266,6 +432,11 @@ public:
     template<class T>
     T get_symbol_value(const std::string&) const;
 
+    TypedValue get_symbol_value(const Symbol) const;
+    void add_symbol(const Symbol, const TypedValue&);
+    void remove_symbol(const Symbol);
+    bool symbol_exists(const Symbol) const;
+
     TypedValue get_symbol_value(const std::string&) const;
     void add_symbol(const std::string&, const TypedValue&);
     void remove_symbol(const std::string&);
@@ -276,17 +447,20 @@ using Graph = Program;
 
 
 template<class T>
-T* Program::get_audio_object_raw_pointer(const std::string& name) const
+T* Program::get_audio_object_raw_pointer(const ObjectRange& object) const
 {
     static_assert(std::is_base_of<AudioObject, T>::value, "Type must be audio object");
-    return static_cast<T*>(table.at(name).get());
+    return static_cast<T*>(objects.at(object.first).get());
 }
 
 template<class Object>
-void Program::create_object(const std::string& name, const ArgumentList& arguments)
+ObjectRange Program::create_object(const Symbol name, const ArgumentList& arguments)
 {
-    if (table.count(name) != 0) error("Symbol '" + name + "' is already used");
-    table[name] = std::make_unique<Object>(arguments);
+    check_name_is_free(name);
+    if (name != unnamed) object_ids[name] = objects.size();
+    objects.push_back(std::make_unique<Object>(arguments));
+    schedule_is_stale = true;
+    return { name, objects.size() - 1, 1, false };
 }
 
 template<class T>
@@ -294,7 +468,7 @@ bool Program::symbol_is_type(const std::string& identifier) const
 {
     if (!symbol_exists(identifier))
         error("Symbol " + identifier + " does not exist, attempted to verify type");
-    return symbol_table.at(identifier).is_type<T>();
+    return symbol_table.at(intern(identifier)).is_type<T>();
 }
 
 template<class T>
@@ -304,7 +478,7 @@ T Program::get_symbol_value(const std::string& identifier) const
         error("Symbol " + identifier + " does not exist, attempted to read value");
     else if (!symbol_is_type<T>(identifier))
         error("Symbol " + identifier + " is wrong type");
-    return symbol_table.at(identifier).get_value<T>();
+    return symbol_table.at(intern(identifier)).get_value<T>();
 }
 
 template<class T>
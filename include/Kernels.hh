@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Volsung {
+
+// Block operations on raw samples, used on the hot paths of the dataflow
+
+void copy_scaled(float* const, const float* const, const size_t, const float);
+void accumulate(float* const, const float* const, const size_t, const float);
+
+void absolute(float* const, const float* const, const size_t);
+void reciprocal(float* const, const float* const, const size_t);
+void clamp(float* const, const float* const, const size_t, const float, const float);
+float dot_product(const float* const, const float* const, const size_t);
+float sum(const float* const, const size_t);
+
+// Approximations of the maths functions, evaluated several samples at a time. Errors are
+// measured against double precision results:
+//   fast_sin, fast_cos  absolute error below 2e-7 for |x| < 8192 and 1e-6 for |x| < 65536,
+//                       past which std::sin and std::cos are used
+//   fast_tanh           relative error below 1.5e-7
+//   fast_atan           relative error below 2.5e-7
+//   fast_exp            relative error below 1e-7, flushing results below 2^-125 to zero
+//   fast_log            relative error below 2e-7
+//   fast_pow            relative error below 1e-7 * (1 + |y ln(x)|)
+
+void fast_sin(float* const, const float* const, const size_t);
+void fast_cos(float* const, const float* const, const size_t);
+void fast_tanh(float* const, const float* const, const size_t);
+void fast_atan(float* const, const float* const, const size_t);
+void fast_exp(float* const, const float* const, const size_t);
+void fast_log(float* const, const float* const, const size_t);
+void fast_pow(float* const, const float* const, const float* const, const size_t);
+void fast_pow(float* const, const float* const, const float, const size_t);
+void fast_pow(float* const, const float, const float* const, const size_t);
+
+// Waveforms of a phase given in turns. The sine takes any phase, the others one in [0, 1).
+// The saw and square also take the phase increment of each sample, and smooth their jumps
+// with polynomial band-limited steps; the square takes the fraction of each period it is high
+void sine_wave(float* const, const float* const, const size_t);
+void triangle_wave(float* const, const float* const, const size_t);
+void saw_wave(float* const, const float* const, const float* const, const size_t);
+void square_wave(float* const, const float* const, const float* const, const float* const, const size_t);
+
+// One operation of a chain of element-wise operations. The operand is read from `operands`,
+// a sample at a time, when they are given, and is `operand` otherwise.
+struct ElementwiseOperation
+{
+    enum class Kind { add, subtract, multiply, divide, power, fast_power, tanh, fast_tanh,
+                      absolute, negate, reciprocal, bi_to_unipolar };
+
+    Kind kind;
+    float operand = 0.f;
+    const float* operands = nullptr;
+};
+
+// Runs the operations one after another on each sample, several samples at a time, keeping the
+// intermediate values in registers rather than writing them out between operations
+void elementwise_chain(float* const, const float* const, const std::vector<ElementwiseOperation>&, const size_t);
+
+// Biquad filters run side by side, several to an instruction. Each array has an entry per
+// filter, padded to a whole number of vectors. The coefficients move by their steps every
+// sample, before they are used.
+struct BiquadBank
+{
+    std::vector<float> b0, b1, b2, a1, a2;
+    std::vector<float> b0_step, b1_step, b2_step, a1_step, a2_step;
+    std::vector<float> x1, x2, y1, y2;
+
+    void resize(const size_t);
+};
+
+// Filters the n-th input into the n-th output with the n-th filter of the bank
+void biquad_bank(BiquadBank&, const float* const* const, float* const* const, const size_t, const size_t);
+
+}
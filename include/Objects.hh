@@ -6,10 +6,14 @@
 #include <random>
 #include <functional>
 #include <queue>
+#include <limits>
 
 #include "VolsungCore.hh"
 #include "AudioObject.hh"
 #include "Graph.hh"
+#include "Convolution.hh"
+#include "Oscillator.hh"
+#include "Kernels.hh"
 
 namespace Volsung {
 
@@ -20,16 +24,24 @@ class AddObject : public AudioObject
 
 public:
     AddObject(const ArgumentList&);
+
+    bool is_identity() const override;
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class DelayObject : public AudioObject
 {
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
     float sample_delay = get_sample_rate();
+    float latency_compensation = 0;
     CircularBuffer delay_buffer;
 
 public:
     DelayObject(const ArgumentList&);
+
+    size_t feedback_delay() const override;
+    void compensate_feedback_latency(const size_t) override;
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class DriveObject : public AudioObject
@@ -38,6 +50,8 @@ class DriveObject : public AudioObject
 
 public:
     DriveObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class FileoutObject : public AudioObject
@@ -52,6 +66,8 @@ class FileoutObject : public AudioObject
 
 public:
     FileoutObject(const ArgumentList&);
+
+    bool has_side_effects() const override;
 };
 
 class FileinObject : public AudioObject
@@ -73,9 +89,12 @@ class FilterObject : public AudioObject
     double b;
     double last_value = 0.f;
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
+    void calculate_coefficients();
 
 public:
     FilterObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class MultObject : public AudioObject
@@ -85,6 +104,9 @@ class MultObject : public AudioObject
 
 public:
     MultObject(const ArgumentList&);
+
+    std::optional<float> constant_gain() const override;
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class NoiseObject : public AudioObject
@@ -96,6 +118,7 @@ class NoiseObject : public AudioObject
 
 public:
     NoiseObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class OscillatorObject : public AudioObject
@@ -103,12 +126,14 @@ class OscillatorObject : public AudioObject
     void  process(const MultichannelBuffer&, MultichannelBuffer&) override;
 
     GateListener sync;
-    double phase     = 0;
+    PhaseAccumulator phase;
     float phase_offset = 0;
     float frequency = 100;
 
 public:
     OscillatorObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class SquareObject : public AudioObject
@@ -116,11 +141,13 @@ class SquareObject : public AudioObject
     void  process(const MultichannelBuffer&, MultichannelBuffer&) override;
 
     float pw        = 0.0;
-    double phase     = 0;
+    PhaseAccumulator phase;
+    std::vector<float> duty_cycles;
     float frequency = 100;
 
 public:
     SquareObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class UserObject : public AudioObject
@@ -132,6 +159,8 @@ class UserObject : public AudioObject
 
 public:
     UserObject(const ArgumentList&, const AudioProcessingCallback, std::any);
+
+    bool has_side_effects() const override;
 };
 
 class AudioInputObject : public AudioObject
@@ -159,6 +188,8 @@ class ComparatorObject : public AudioObject
 
 public:
     ComparatorObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class TimerObject : public AudioObject
@@ -169,6 +200,8 @@ class TimerObject : public AudioObject
 
 public:
     TimerObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class ClockObject : public AudioObject
@@ -180,6 +213,8 @@ class ClockObject : public AudioObject
 
 public:
     ClockObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class DivisionObject : public AudioObject
@@ -189,6 +224,9 @@ class DivisionObject : public AudioObject
 
 public:
     DivisionObject(const ArgumentList&);
+
+    bool is_identity() const override;
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class SubtractionObject : public AudioObject
@@ -198,6 +236,9 @@ class SubtractionObject : public AudioObject
 
 public:
     SubtractionObject(const ArgumentList&);
+
+    bool is_identity() const override;
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class ModuloObject : public AudioObject
@@ -207,6 +248,8 @@ class ModuloObject : public AudioObject
 
 public:
     ModuloObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class AbsoluteValueObject : public AudioObject
@@ -215,6 +258,8 @@ class AbsoluteValueObject : public AudioObject
 
 public:
     AbsoluteValueObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class StepSequence : public AudioObject
@@ -235,6 +280,8 @@ class PowerObject : public AudioObject
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     PowerObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class EnvelopeObject : public AudioObject
@@ -249,6 +296,7 @@ class EnvelopeObject : public AudioObject
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     EnvelopeObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class RoundObject : public AudioObject
@@ -256,6 +304,8 @@ class RoundObject : public AudioObject
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     RoundObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class SequenceObject : public AudioObject
@@ -274,6 +324,8 @@ class SampleAndHoldObject : public AudioObject
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     SampleAndHoldObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class ConstObject : public AudioObject
@@ -283,22 +335,25 @@ class ConstObject : public AudioObject
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     ConstObject(const ArgumentList&);
+
+    bool is_pure() const override;
 };
 
 class SawObject : public AudioObject
 {
-    double phase = -1;
+    PhaseAccumulator phase;
     float frequency;
     GateListener sync;
 
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
 public:
     SawObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class TriangleObject : public AudioObject
 {
-    double phase = 0;
+    PhaseAccumulator phase;
     float frequency;
     GateListener sync;
 
@@ -306,33 +361,68 @@ class TriangleObject : public AudioObject
 
 public:
     TriangleObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class BiquadObject : public AudioObject
 {
+    friend class BiquadGroup;
+
+    struct Coefficients
+    {
+        float b0, b1, b2, a1, a2;
+    };
+
+    // Normalised by a0, and only recalculated when the parameters they were made from change
+    Coefficients coefficients = { 0, 0, 0, 0, 0 };
+    float coefficient_frequency = std::numeric_limits<float>::quiet_NaN();
+    float coefficient_resonance = std::numeric_limits<float>::quiet_NaN();
+
+    float x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
+    void update_coefficients();
+    Coefficients coefficients_for(const float, const float) const;
+
+    // Returns the coefficients for the start of the block, and sets the step they take each sample
+    Coefficients block_coefficients(Coefficients&);
+
 protected:
-    float a0, a1, a2, b0, b1, b2;
+    struct Design
+    {
+        float a0, a1, a2, b0, b1, b2;
+    };
 
     float frequency;
     float resonance = 1.f;
 
-    float omega;
-    float alpha;
-    float cos_omega;
-    float A;
+    // The coefficients of the kind of filter, given alpha, cos(omega) and the resonance
+    virtual Design calculate_coefficients(const float, const float, const float) const = 0;
 
-    CircularBuffer x, y;
+public:
+    std::unique_ptr<ObjectGroup> make_group() const override;
+    BiquadObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
+};
+
+// Biquads of any kind, run side by side in a bank
+class BiquadGroup : public ObjectGroup
+{
+    BiquadBank bank;
+    std::vector<const float*> member_inputs;
+    std::vector<float*> member_outputs;
 
-    virtual void calculate_coefficients() = 0;
+    void add(AudioObject* const) override;
+    void process_members(const std::vector<AudioObject*>&, const size_t) override;
 
 public:
-    BiquadObject(const ArgumentList&);
+    bool accepts(const AudioObject* const) const override;
 };
 
 class LowpassObject : public BiquadObject
 {
-    void calculate_coefficients() override;
+    Design calculate_coefficients(const float, const float, const float) const override;
 public:
     LowpassObject(const ArgumentList& parameters) :
         BiquadObject(parameters) { }
@@ -340,7 +430,7 @@ public:
 
 class HighpassObject : public BiquadObject
 {
-    void calculate_coefficients() override;
+    Design calculate_coefficients(const float, const float, const float) const override;
 public:
     HighpassObject(const ArgumentList& parameters) :
         BiquadObject(parameters) { }
@@ -348,7 +438,7 @@ public:
 
 class BandpassObject : public BiquadObject
 {
-    void calculate_coefficients() override;
+    Design calculate_coefficients(const float, const float, const float) const override;
 public:
     BandpassObject(const ArgumentList& parameters) :
         BiquadObject(parameters) { }
@@ -356,7 +446,7 @@ public:
 
 class AllpassObject : public BiquadObject
 {
-    void calculate_coefficients() override;
+    Design calculate_coefficients(const float, const float, const float) const override;
 public:
     AllpassObject(const ArgumentList& parameters) :
         BiquadObject(parameters) { }
@@ -374,6 +464,7 @@ class EnvelopeFollowerObject : public AudioObject
 
 public:
     EnvelopeFollowerObject(const ArgumentList&);
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class SubgraphObject : public AudioObject
@@ -383,13 +474,14 @@ class SubgraphObject : public AudioObject
 public:
     std::unique_ptr<Program> graph;
     SubgraphObject(const ArgumentList&);
+
+    bool has_side_effects() const override;
 };
 
 class ConvolveObject : public AudioObject
 {
     void process(const MultichannelBuffer&, MultichannelBuffer&) override;
-    CircularBuffer signal;
-    Sequence impulse_response;
+    std::unique_ptr<Convolution> convolution;
 public:
     ConvolveObject(const ArgumentList&);
 };
@@ -426,6 +518,8 @@ class BiToUnipolarObject : public AudioObject
 
 public:
     BiToUnipolarObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 
@@ -437,6 +531,8 @@ class CeilObject : public AudioObject
 
 public:
     CeilObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class CosObject : public AudioObject
@@ -445,6 +541,8 @@ class CosObject : public AudioObject
 
 public:
     CosObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class SinObject : public AudioObject
@@ -453,6 +551,8 @@ class SinObject : public AudioObject
 
 public:
     SinObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class ClampObject : public AudioObject
@@ -462,6 +562,8 @@ class ClampObject : public AudioObject
     float max = 1.f;
 public:
     ClampObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class ReciprocalObject : public AudioObject
@@ -470,6 +572,8 @@ class ReciprocalObject : public AudioObject
 
 public:
     ReciprocalObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 class InverseObject : public AudioObject
@@ -478,6 +582,8 @@ class InverseObject : public AudioObject
     float offset;
 public:
     InverseObject(const ArgumentList&);
+
+    std::optional<ElementwiseOperation> elementwise_operation() const override;
 };
 
 
@@ -491,6 +597,8 @@ class SignObject : public AudioObject
 
 public:
     SignObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 class LogarithmObject : public AudioObject
@@ -531,6 +639,8 @@ class PhasorObject : public AudioObject
 
 public:
     PhasorObject(const ArgumentList&);
+
+    std::optional<ObjectCode> generate_code() const override;
 };
 
 
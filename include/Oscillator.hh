@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace Volsung {
+
+// The phase of an oscillator, in turns and kept in [0, 1). A block's worth of phases, and the
+// increment at each of them, are written out first, so that the waveform can then be computed
+// over the whole block with the kernels.
+class PhaseAccumulator
+{
+    double phase = 0;
+    float sample_period;
+    std::vector<float> phases;
+    std::vector<float> increments;
+
+public:
+    // Starts a block of the given length
+    void begin_block(const size_t);
+
+    // Fills the whole block at a constant frequency
+    void run(const float);
+
+    // Fills one sample, for when the frequency changes during the block
+    void step(const size_t, const float);
+
+    void reset(const double = 0);
+
+    float* get_phases();
+    const float* get_increments() const;
+    double get_phase() const;
+    float get_sample_period() const;
+
+    PhaseAccumulator();
+};
+
+}
@@ -4,9 +4,13 @@
 #include <tuple>
 #include <variant>
 #include <exception>
+#include <string_view>
+#include <cstdint>
 
 #include "VolsungCore.hh"
 #include "Objects.hh"
+#include "SyntaxTree.hh"
+#include "Evaluator.hh"
 
 namespace Volsung {
 
@@ -86,26 +90,45 @@ inline const std::map<TokenType, std::string> debug_names = {
     { TokenType::eof, "end-of-file" }
 };
 
+// A token refers to the source code it was lexed from. The value of identifiers, object types,
+// numbers, and strings is their text, leaving out the `~` after object types and the quotes
+// around strings, and it's empty for other tokens.
 struct Token
 {
     TokenType type;
-    std::string value;
+    std::string_view value;
+
+    // Where the token starts in the source code
+    uint32_t line = 0;
+    uint32_t column = 0;
+    uint32_t offset = 0;
 };
 
 
 class Lexer
 {
+    size_t cursor = 0;
+    size_t line_start = 0;
+
+    int current() const;
     bool is_digit() const;
     bool is_char() const;
+    Token lex_token();
+    TokenType next_type() const;
 
 protected:
-    int current() const;
-    Token get_next_token();
-    bool peek(const TokenType);
-    bool peek_expression();
-    bool peek_connection();
+    const Token& get_next_token();
+    bool peek(const TokenType) const;
+    bool peek_expression() const;
+    bool peek_connection() const;
     virtual ~Lexer() = 0;
 
+    // Lexes the whole of the source code in one pass, ending with an end-of-file token, and
+    // reads the tokens from the start. Their values refer to the source code, which mustn't
+    // change until they're parsed.
+    void lex();
+
+    std::vector<Token> tokens;
     size_t line = 1;
     size_t position = (size_t) -1;
 
@@ -113,41 +136,46 @@ public:
      std::string source_code;
 };
 
+// Parses the source code into a syntax tree, and has an Evaluator run it on the program. The
+// tree is kept, and run again when a program is parsed from the same source code.
 class Parser : public Lexer
 {
     Token current_token = { TokenType::invalid, "" };
-    Token next_token();
+    const Token& next_token();
     void error(const std::string&) const;
     void expect(const TokenType);
     void verify(const TokenType) const;
     bool line_end() const;
     bool current_token_is(const TokenType) const;
 
-    void parse_declaration();
-    void parse_subgraph_declaration();
-    void parse_connection();
-    void parse_connection(std::string);
-
-    Sequence parse_sequence();
-    Number parse_number();
-    void parse_directive();
-    TypedValue parse_identifier();
-    TypedValue parse_procedure_call(TypedValue, TypedValue = 0, bool = false);
-
-    std::string get_object_to_connect();
-    void make_object(const std::string&, const std::string&, const ArgumentList&);
-    std::string parse_object_declaration(std::string = "");
-
-    TypedValue parse_expression();
-    TypedValue parse_sequence_generator();
-    TypedValue parse_product();
-    TypedValue parse_power();
-    TypedValue parse_unary_postfix();
-    TypedValue parse_backtick_operator();
-    TypedValue parse_factor();
-
-    int inline_object_index = 0;
-    Graph* program = nullptr;
+    Statement make_statement(const Statement::Kind) const;
+    std::unique_ptr<Expression> make_expression(const Expression::Kind) const;
+
+    Block parse_block(const bool);
+    Statement parse_statement();
+    Statement parse_declaration();
+    Statement parse_subgraph_declaration();
+    Statement parse_connection(ObjectReference);
+    Statement parse_directive();
+    int parse_output_index();
+
+    ObjectReference parse_object_reference();
+    std::unique_ptr<ObjectDeclaration> parse_object_declaration(const Symbol = unnamed);
+
+    std::unique_ptr<Expression> parse_expression();
+    std::unique_ptr<Expression> parse_sequence_generator();
+    std::unique_ptr<Expression> parse_product();
+    std::unique_ptr<Expression> parse_power();
+    std::unique_ptr<Expression> parse_unary_postfix();
+    std::unique_ptr<Expression> parse_factor();
+    std::unique_ptr<Expression> parse_function();
+    std::unique_ptr<Expression> parse_number();
+    std::unique_ptr<Expression> parse_sequence();
+    std::unique_ptr<Expression> parse_identifier();
+    std::unique_ptr<Expression> parse_procedure_call(std::unique_ptr<Expression>, std::unique_ptr<Expression> = nullptr);
+
+    std::shared_ptr<const Block> syntax_tree;
+    std::string parsed_source;
 
     std::function<void()> parse_hook;
 
@@ -157,4 +185,3 @@ public:
 };
 
 }
-
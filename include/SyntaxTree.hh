@@ -0,0 +1,102 @@
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+
+#include "Graph.hh"
+
+namespace Volsung {
+
+// The syntax tree of a program, built by the Parser and run by the Evaluator. Nodes keep the
+// line they start on, so that errors found while they're evaluated can say where they are.
+
+struct Expression
+{
+    enum class Kind {
+        literal,             // `value`
+        duration,            // `value` seconds, over `divisor`, in samples at the sample rate
+        identifier,          // `symbol`, looked up `parent_levels` programs up, one for each backtick
+        sequence,            // { operands... }
+        function,            // |parameters...| { operands[0] }, the body being left out if it's empty
+        add,
+        subtract,
+        multiply,
+        divide,
+        power,
+        negate,
+        range,               // operands[0]..operands[1], in steps of operands[2] if there is one
+        interpolated_range,  // operands[1] elements evenly spaced from operands[0] to operands[2]
+        subscript,           // operands[0][operands[1]]
+        call,                // operands[0](operands[1...]), the procedure being written as `name`
+        method_call          // operands[0].operands[1](operands[2...]), the procedure being `name`
+    };
+
+    Kind kind;
+    size_t line;
+    TypedValue value = 0;
+    float divisor = 1;
+    std::string name;
+    Symbol symbol = unnamed;
+    size_t parent_levels = 0;
+    std::vector<Symbol> parameters;
+    std::vector<std::unique_ptr<Expression>> operands;
+};
+
+struct ObjectDeclaration
+{
+    size_t line;
+    Symbol name = unnamed;               // Left unnamed for objects declared where they're connected
+    std::unique_ptr<Expression> count;   // The number of members of a group, declared with `[count]`
+    std::string type;
+    std::vector<std::unique_ptr<Expression>> arguments;
+};
+
+// An object in a connection, either declared there or named, and then maybe a member of a group
+struct ObjectReference
+{
+    size_t line;
+    Symbol name = unnamed;
+    std::unique_ptr<ObjectDeclaration> declaration;
+    std::unique_ptr<Expression> index;
+};
+
+// Connects an output of the object before it to an input of the target. When `series` is set,
+// written `-->`, the target is a group whose members are connected one after the other.
+struct Connection
+{
+    ConnectionType type;
+    bool series;
+    int input;
+    ObjectReference target;
+    int output;
+};
+
+struct Statement
+{
+    enum class Kind {
+        expression,            // expressions[0]
+        symbol_declaration,    // name: expressions[0]
+        connection,            // object|output, then the connections
+        subgraph_declaration,  // name <expressions[0], expressions[1]>: { body }
+        directive              // &name expressions...
+    };
+
+    Kind kind;
+    size_t line;
+    std::string name;
+    Symbol symbol = unnamed;             // The name of a declaration, interned
+    std::vector<std::unique_ptr<Expression>> expressions;
+
+    ObjectReference object;
+    int output = 0;
+    std::vector<Connection> connections;
+
+    std::vector<Statement> body;
+    std::string text;
+};
+
+using Block = std::vector<Statement>;
+
+}
@@ -4,6 +4,9 @@
 /*! \file */ 
 
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <iostream>
 #include <unordered_map>
@@ -27,6 +30,14 @@ void set_debug_callback(std::function<void(std::string)>);
 void set_library_path(const std::string&);
 std::string get_library_path();
 
+// Names of objects, groups and symbols are interned, each distinct name getting a dense ID that
+// it keeps for the rest of the run, so that the tables of programs are keyed by integers
+using Symbol = uint32_t;
+constexpr Symbol unnamed = std::numeric_limits<Symbol>::max();
+
+Symbol intern(std::string_view);
+const std::string& symbol_name(const Symbol);
+
 
 template <typename T>
 int sign(const T val)
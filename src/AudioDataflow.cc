@@ -1,22 +1,63 @@
 
+#include <algorithm>
+
 #include "AudioDataflow.hh"
 #include "VolsungCore.hh"
+#include "Kernels.hh"
 
 namespace Volsung {
 
 
 float* AudioBuffer::data_pointer()
 {
-    return (float*) data.get();
+    return data;
+}
+
+const float* AudioBuffer::data_pointer() const
+{
+    return data;
+}
+
+size_t AudioBuffer::size() const
+{
+    return length;
+}
+
+AudioBuffer AudioBuffer::view(const size_t offset, const size_t view_length) const
+{
+    return AudioBuffer(data + offset, view_length);
+}
+
+AudioBuffer::AudioBuffer() : AudioBuffer(default_blocksize) { }
+
+AudioBuffer::AudioBuffer(const size_t buffer_length) : length(buffer_length)
+{
+    storage = std::make_shared<std::vector<float>>(buffer_length, 0.f);
+    data = storage->data();
+}
+
+AudioBuffer::AudioBuffer(float* const samples, const size_t buffer_length)
+    : data(samples), length(buffer_length) { }
+
+const AudioBuffer AudioBuffer::zero(max_blocksize);
+
+
+void BufferArena::allocate(const size_t size, const size_t slot_length)
+{
+    constexpr size_t line_length = sizeof(Line::samples) / sizeof(float);
+    lines_per_slot = (slot_length + line_length - 1) / line_length;
+    lines.assign(size * lines_per_slot, Line { });
 }
 
-AudioBuffer::AudioBuffer()
+AudioBuffer BufferArena::slot(const size_t index, const size_t length)
 {
-    data = std::make_shared<Block>();
-    *data = { 0 };
+    return AudioBuffer(lines[index * lines_per_slot].samples, length);
 }
 
-const AudioBuffer AudioBuffer::zero;
+size_t BufferArena::size() const
+{
+    return lines_per_slot ? lines.size() / lines_per_slot : 0;
+}
 
 
 float& CircularBuffer::operator[](long n)
@@ -46,6 +87,11 @@ void CircularBuffer::increment_pointer()
     if (pointer >= stream.size()) pointer -= stream.size();
 }
 
+size_t CircularBuffer::size() const
+{
+    return stream.size();
+}
+
 CircularBuffer::CircularBuffer(size_t size)
 {
     resize_stream(size);
@@ -56,31 +102,43 @@ bool AudioInput::is_connected() const
     return bool(connections.size());
 }
 
-const AudioBuffer AudioInput::read_buffer() const
-{
-    switch (connections.size()) {
-        case (0): return AudioBuffer::zero;
-        case (1): return connections[0]->stored_buffer;
-        default: {
-            AudioBuffer ret;
-            for (size_t n = 0; n < connections.size(); n++) {
-                for (size_t s = 0; s < AudioBuffer::blocksize; s++) {
-                    ret[s] += connections[n]->stored_buffer[s];
-                }
-            }
-            return ret;
-        }
+AudioBuffer AudioConnector::read(const size_t offset, const size_t length)
+{
+    if (!delay) return stored_buffer.view(offset, length);
+    if (history.empty()) return stored_buffer.view((offset + period - delay) % period, length);
+
+    const AudioBuffer late = offset < delay ? AudioBuffer(history.data() + history_half * delay, length)
+                                            : stored_buffer.view(offset - delay, length);
+    if (offset + length == period) {
+        history_half ^= 1;
+        std::copy_n(stored_buffer.data_pointer() + period - delay, delay, history.data() + history_half * delay);
     }
+    return late;
+}
 
-    return AudioBuffer::zero;
+bool AudioInput::is_mixed() const
+{
+    return connections.size() > 1 || (connections.size() == 1 && connections[0]->gain != 1.f);
 }
 
-void AudioOutput::write_buffer(const AudioBuffer buffer)
+const AudioBuffer AudioInput::read_buffer(const size_t offset, const size_t length)
 {
-    if (connections.size() == 0) return;
-    connections[0]->stored_buffer = buffer;
+    if (!connections.size()) return AudioBuffer::zero.view(0, length);
+    if (!is_mixed()) return connections[0]->read(offset, length);
+
+    AudioBuffer ret = mix.view(offset, length);
+    copy_scaled(ret.data_pointer(), connections[0]->read(offset, length).data_pointer(), length, connections[0]->gain);
+
     for (size_t n = 1; n < connections.size(); n++) {
-        connections[n]->stored_buffer = buffer;
+        accumulate(ret.data_pointer(), connections[n]->read(offset, length).data_pointer(), length, connections[n]->gain);
+    }
+    return ret;
+}
+
+void AudioOutput::bind(const AudioBuffer buffer)
+{
+    for (auto& connector : connections) {
+        connector->stored_buffer = buffer;
     }
 }
 
@@ -2,6 +2,9 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
 
 #include "AudioObject.hh"
 #include "Graph.hh"
@@ -10,27 +13,219 @@ namespace Volsung {
 
 void AudioObject::finish() { }
 
-void AudioObject::implement()
+size_t AudioObject::feedback_delay() const
 {
+    return 0;
+}
+
+void AudioObject::compensate_feedback_latency(const size_t) { }
+
+std::unique_ptr<ObjectGroup> AudioObject::make_group() const
+{
+    return nullptr;
+}
+
+void AudioObject::implement(const size_t offset, const size_t length)
+{
+    begin_block(offset, length);
+    if (passes_through) return;
+
+    process(in, out_views);
+    end_block(offset, length);
+}
+
+void AudioObject::begin_block(const size_t offset, const size_t length)
+{
+    current_blocksize = length;
+
     for (size_t n = 0; n < inputs.size(); n++)
     {
-        in[n] = inputs[n].read_buffer();
+        in[n] = inputs[n].read_buffer(offset, length);
     }
 
-    process(in, out);
+    if (passes_through) return;
+
+    modulated_values.clear();
+    for (auto const& value : linked_values) {
+        if (inputs[value.input].is_connected()) modulated_values.push_back(value);
+    }
 
     for (size_t n = 0; n < outputs.size(); n++)
     {
-        outputs[n].write_buffer(out[n]);
+        out_views[n] = out[n].view(offset, length);
+    }
+}
+
+void AudioObject::end_block(const size_t offset, const size_t length)
+{
+    for (size_t n = 0; n < outputs.size(); n++)
+    {
+        // Objects may hand back a different buffer rather than writing into the one given
+        float* const destination = out[n].data_pointer() + offset;
+        if (out_views[n].data_pointer() != destination)
+            std::copy_n(out_views[n].begin(), std::min(length, out_views[n].size()), destination);
+    }
+}
+
+void AudioObject::bind_block(const size_t length)
+{
+    current_blocksize = length;
+
+    for (size_t n = 0; n < inputs.size(); n++) {
+        if (!inputs[n].is_connected()) in[n] = AudioBuffer::zero.view(0, length);
+        else if (inputs[n].is_mixed()) in[n] = inputs[n].mix.view(0, length);
+        else in[n] = inputs[n].connections[0]->read(0, length);
+    }
+
+    modulated_values.clear();
+    for (auto const& value : linked_values) {
+        if (inputs[value.input].is_connected()) modulated_values.push_back(value);
+    }
+
+    for (size_t n = 0; n < outputs.size(); n++) {
+        out_views[n] = out[n].view(0, length);
     }
 }
 
+void AudioObject::run_block()
+{
+    process(in, out_views);
+
+    for (size_t n = 0; n < outputs.size(); n++) {
+        float* const destination = out[n].data_pointer();
+        if (out_views[n].data_pointer() == destination) continue;
+
+        std::copy_n(out_views[n].begin(), std::min(current_blocksize, out_views[n].size()), destination);
+        out_views[n] = out[n].view(0, current_blocksize);
+    }
+}
+
+void AudioObject::bind_output(const size_t output, const AudioBuffer buffer)
+{
+    out[output] = buffer;
+    outputs[output].bind(buffer);
+}
+
+bool AudioObject::can_process_in_place() const
+{
+    return in_place;
+}
+
+void AudioObject::enable_in_place_processing()
+{
+    in_place = true;
+}
+
+std::optional<float> AudioObject::constant_gain() const
+{
+    return std::nullopt;
+}
+
+void AudioObject::pass_through(const bool enabled)
+{
+    passes_through = enabled;
+}
+
+bool AudioObject::is_passing_through() const
+{
+    return passes_through;
+}
+
+bool AudioObject::is_pure() const
+{
+    return in_place;
+}
+
+std::optional<ElementwiseOperation> AudioObject::elementwise_operation() const
+{
+    return std::nullopt;
+}
+
+std::optional<ObjectCode> AudioObject::generate_code() const
+{
+    using Kind = ElementwiseOperation::Kind;
+    const std::optional<ElementwiseOperation> operation = elementwise_operation();
+    if (!operation) return std::nullopt;
+
+    const std::string operand = inputs.size() > 1 ? parameter_code(1, operation->operand) : "";
+    ObjectCode code;
+    switch (operation->kind) {
+        case Kind::add:            code.sample = "$out0 = $in0 + " + operand + ";\n"; break;
+        case Kind::subtract:       code.sample = "$out0 = $in0 - " + operand + ";\n"; break;
+        case Kind::multiply:       code.sample = "$out0 = $in0 * " + operand + ";\n"; break;
+        case Kind::divide:         code.sample = "$out0 = $in0 / " + operand + ";\n"; break;
+        case Kind::power:          code.sample = "$out0 = std::pow($in0, " + operand + ");\n"; break;
+        case Kind::tanh:           code.sample = "$out0 = std::tanh($in0);\n"; break;
+        case Kind::absolute:       code.sample = "$out0 = std::fabs($in0);\n"; break;
+        case Kind::negate:         code.sample = "$out0 = -$in0;\n"; break;
+        case Kind::reciprocal:     code.sample = "$out0 = 1.f / $in0;\n"; break;
+        case Kind::bi_to_unipolar: code.sample = "$out0 = 0.5f + 0.5f * $in0;\n"; break;
+
+        // The approximations are only written for the kernels
+        case Kind::fast_power:
+        case Kind::fast_tanh:
+            return std::nullopt;
+    }
+    return code;
+}
+
+std::string AudioObject::parameter_code(const uint input, const float value) const
+{
+    return is_connected(input) ? "$in" + std::to_string(input) : literal(value);
+}
+
+std::string AudioObject::literal(const float value)
+{
+    if (std::isnan(value)) return "std::numeric_limits<float>::quiet_NaN()";
+    if (std::isinf(value)) return value > 0 ? "std::numeric_limits<float>::infinity()" : "-std::numeric_limits<float>::infinity()";
+
+    // Nine significant digits are enough to read back the same float
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    const std::string digits = text;
+    return digits + (digits.find_first_of(".e") == std::string::npos ? ".f" : "f");
+}
+
+std::string AudioObject::literal(const double value)
+{
+    if (std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+    if (std::isinf(value)) return value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.17g", value);
+    const std::string digits = text;
+    return digits + (digits.find_first_of(".e") == std::string::npos ? ".0" : "");
+}
+
+std::string AudioObject::gate_code(const std::string& input)
+{
+    const std::string threshold = literal(gate_threshold);
+    return "const bool $opened = " + input + " >= " + threshold + " && $gate < " + threshold + ";\n"
+           "$gate = " + input + ";\n";
+}
+
+bool AudioObject::is_identity() const
+{
+    return constant_gain() == 1.f;
+}
+
+bool AudioObject::has_side_effects() const
+{
+    return false;
+}
+
+void AudioObject::use_fast_math(const bool enabled)
+{
+    fast_math = enabled;
+}
+
 void AudioObject::set_io(const uint num_inputs, const uint num_outputs)
 {
     outputs.resize(num_outputs);
     inputs.resize(num_inputs);
 
     out.resize(num_outputs);
+    out_views.resize(num_outputs);
     in.resize(num_inputs);
 }
 
@@ -51,9 +246,8 @@ void AudioObject::link_value(float* const parameter, const float default_value,
 
 void AudioObject::update_parameters(size_t n)
 {
-    for (auto const& value : linked_values) {
-        if (inputs[value.input].is_connected())
-            *value.parameter = in[value.input][n];
+    for (auto const& value : modulated_values) {
+        *value.parameter = in[value.input][n];
     }
 }
 
@@ -69,6 +263,11 @@ GateState operator| (GateState lhs, GateState rhs)
     return static_cast<GateState> (static_cast<T> (lhs) | static_cast<T> (rhs));
 }
 
+float GateListener::get_last_value() const
+{
+    return last_value;
+}
+
 GateState GateListener::read_gate_state(float current_value)
 {
     const float _last_value = last_value;
@@ -86,4 +285,62 @@ GateState GateListener::read_gate_state(float current_value)
     return GateState::just_closed | GateState::closed;
 }
 
+void ObjectGroup::add_member(AudioObject* const member)
+{
+    // Members are run by the group, on their inputs as they are
+    member->pass_through(false);
+    members.push_back(member);
+    add(member);
+}
+
+const std::vector<AudioObject*>& ObjectGroup::get_members() const
+{
+    return members;
+}
+
+void ObjectGroup::implement(const size_t offset, const size_t length)
+{
+    current_blocksize = length;
+    for (AudioObject* const member : members) member->begin_block(offset, length);
+    process_members(members, length);
+    for (AudioObject* const member : members) member->end_block(offset, length);
+}
+
+void ObjectGroup::process(const MultichannelBuffer&, MultichannelBuffer&)
+{
+    process_members(members, blocksize());
+}
+
+const float* ObjectGroup::input_of(const AudioObject* const member, const size_t input)
+{
+    return member->in[input].data_pointer();
+}
+
+float* ObjectGroup::output_of(AudioObject* const member, const size_t output)
+{
+    return member->out_views[output].data_pointer();
+}
+
+void ElementwiseChain::add(AudioObject* const)
+{
+    operations.emplace_back();
+}
+
+bool ElementwiseChain::accepts(const AudioObject* const object) const
+{
+    return object->outputs.size() == 1 && object->elementwise_operation().has_value();
+}
+
+void ElementwiseChain::process_members(const std::vector<AudioObject*>& members, const size_t length)
+{
+    // Parameters may have changed since the last block, so the operations are described afresh
+    for (size_t n = 0; n < members.size(); n++) {
+        operations[n] = *members[n]->elementwise_operation();
+        const bool modulated = members[n]->inputs.size() > 1 && members[n]->is_connected(1);
+        operations[n].operands = modulated ? input_of(members[n], 1) : nullptr;
+    }
+
+    elementwise_chain(output_of(members.back(), 0), input_of(members.front(), 0), operations, length);
+}
+
 }
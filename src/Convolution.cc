@@ -0,0 +1,117 @@
+
+#include <cmath>
+#include <algorithm>
+
+#include "Convolution.hh"
+#include "Kernels.hh"
+
+namespace Volsung {
+
+static size_t choose_partition_size(const size_t length)
+{
+    // Balances the direct-form head, which costs one multiply per tap and sample, against
+    // the number of partitions the frequency domain part has to go through
+    size_t size = 64;
+    while (size * size < length && size < 8192) size *= 2;
+    return size;
+}
+
+Convolution::DirectForm::DirectForm(const float* const taps, const size_t length)
+    : reversed_taps(taps, taps + length), history(2 * length, 0.f)
+{
+    std::reverse(reversed_taps.begin(), reversed_taps.end());
+}
+
+float Convolution::DirectForm::process(const float sample)
+{
+    const size_t length = reversed_taps.size();
+    if (!length) return 0.f;
+
+    // The history is written twice, so that the most recent `length` samples are always contiguous
+    history[position] = history[position + length] = sample;
+    position = (position + 1) % length;
+
+    return dot_product(reversed_taps.data(), history.data() + position, length);
+}
+
+Convolution::Convolution(const std::vector<float>& impulse_response)
+    : head(impulse_response.data(), impulse_response.size() > fft_threshold
+                                    ? choose_partition_size(impulse_response.size())
+                                    : impulse_response.size())
+{
+    if (impulse_response.size() <= fft_threshold) return;
+
+    partition_size = choose_partition_size(impulse_response.size());
+    const size_t fft_size = 2 * partition_size;
+    const size_t bins = partition_size + 1;
+    fft = std::make_unique<RealFFT>(fft_size);
+
+    std::vector<float> padded(fft_size);
+    for (size_t start = partition_size; start < impulse_response.size(); start += partition_size) {
+        std::fill(padded.begin(), padded.end(), 0.f);
+        const size_t end = std::min(start + partition_size, impulse_response.size());
+        std::copy(impulse_response.begin() + start, impulse_response.begin() + end, padded.begin());
+
+        std::vector<Complex> partition(bins);
+        fft->forward(padded.data(), partition.data());
+        partitions.push_back(std::move(partition));
+    }
+
+    input_spectra.assign(partitions.size(), std::vector<Complex>(bins));
+    input_blocks.assign(fft_size, 0.f);
+    output_block.resize(fft_size);
+    tail.assign(partition_size, 0.f);
+    scratch.resize(bins);
+}
+
+void Convolution::calculate_tail()
+{
+    const size_t bins = partition_size + 1;
+
+    newest_spectrum = (newest_spectrum + 1) % input_spectra.size();
+    fft->forward(input_blocks.data(), input_spectra[newest_spectrum].data());
+
+    std::copy(input_blocks.begin() + partition_size, input_blocks.end(), input_blocks.begin());
+
+    // The next block gets partition j applied to the input from j blocks before it, which
+    // for j >= 1 has all arrived by now
+    std::fill(scratch.begin(), scratch.end(), Complex(0.f, 0.f));
+    for (size_t j = 0; j < partitions.size(); j++) {
+        const std::vector<Complex>& input = input_spectra[(newest_spectrum + input_spectra.size() - j) % input_spectra.size()];
+        const std::vector<Complex>& partition = partitions[j];
+
+        for (size_t k = 0; k < bins; k++) {
+            const float real = input[k].real() * partition[k].real() - input[k].imag() * partition[k].imag();
+            const float imag = input[k].real() * partition[k].imag() + input[k].imag() * partition[k].real();
+            scratch[k] = Complex(scratch[k].real() + real, scratch[k].imag() + imag);
+        }
+    }
+
+    fft->inverse(scratch.data(), output_block.data());
+    const float scale = 1.f / float(2 * partition_size);
+    for (size_t n = 0; n < partition_size; n++) {
+        tail[n] = output_block[partition_size + n] * scale;
+    }
+}
+
+void Convolution::process(const float* const input, float* const output, const size_t length)
+{
+    for (size_t n = 0; n < length; n++) {
+        const float sample = input[n];
+        float value = head.process(sample);
+
+        if (partition_size) {
+            value += tail[block_position];
+            input_blocks[partition_size + block_position] = sample;
+
+            if (++block_position == partition_size) {
+                calculate_tail();
+                block_position = 0;
+            }
+        }
+
+        output[n] = value;
+    }
+}
+
+}
@@ -0,0 +1,471 @@
+
+#include <cmath>
+#include <algorithm>
+
+#include "Evaluator.hh"
+#include "Objects.hh"
+
+namespace Volsung {
+
+using ObjectMap = std::map<std::string, ObjectRange(Program::*)(const Symbol, const ArgumentList&)>;
+#define OBJECT(x) &Program::create_object<x>
+static const ObjectMap object_creators =
+{
+    // Signal generation
+    { "Sine_Oscillator",     OBJECT(OscillatorObject) },
+    { "Saw_Oscillator",      OBJECT(SawObject) },
+    { "Square_Oscillator",   OBJECT(SquareObject) },
+    { "Triangle_Oscillator", OBJECT(TriangleObject) },
+    { "Noise",               OBJECT(NoiseObject) },
+    { "Constant",            OBJECT(ConstObject) },
+    { "Clock",               OBJECT(ClockObject) },
+    { "Timer",               OBJECT(TimerObject) },
+    { "Phasor",              OBJECT(PhasorObject) },
+
+    // Arithmetic
+    { "Add",                 OBJECT(AddObject) },
+    { "Multiply",            OBJECT(MultObject) },
+    { "Subtract",            OBJECT(SubtractionObject) },
+    { "Divide",              OBJECT(DivisionObject) },
+    { "Power",               OBJECT(PowerObject) },
+    { "Exponentiate",        OBJECT(ExponentialObject) },
+
+    // Signal processing
+    { "Delay_Line",          OBJECT(DelayObject) },
+    { "Sample_And_Hold",     OBJECT(SampleAndHoldObject) },
+    { "Envelope_Follower",   OBJECT(EnvelopeFollowerObject) },
+    { "Envelope_Generator",  OBJECT(EnvelopeObject) },
+    { "Clamp",               OBJECT(ClampObject) },
+    { "Inverse",             OBJECT(InverseObject) },
+    { "Comparator",          OBJECT(ComparatorObject) },
+    { "Reciprocal",          OBJECT(ReciprocalObject) },
+    { "Bi_to_Unipolar",      OBJECT(BiToUnipolarObject) },
+    { "Invoke",              OBJECT(InvokeBlockwiseObject) },
+
+    // Maths functions
+    { "Sin",                 OBJECT(SinObject) },
+    { "Cos",                 OBJECT(CosObject) },
+    { "Tanh",                OBJECT(DriveObject) },
+    { "Modulo",              OBJECT(ModuloObject) },
+    { "Abs",                 OBJECT(AbsoluteValueObject) },
+    { "Floor",               OBJECT(RoundObject) },
+    { "Ceil",                OBJECT(CeilObject) },
+    { "Sign",                OBJECT(SignObject) },
+    { "Log",                 OBJECT(LogarithmObject) },
+    { "Atan",                OBJECT(AtanObject) },
+
+    // Sequences
+    { "Write_File",          OBJECT(FileoutObject) },
+    { "Read_File",           OBJECT(FileinObject) },
+    { "Step_Sequence",       OBJECT(StepSequence) },
+    { "Index_Sequence",      OBJECT(SequenceObject) },
+
+    // Frequency filters and frequency filter design
+    { "Smooth",              OBJECT(FilterObject) },
+    { "Lowpass_Filter",      OBJECT(LowpassObject) },
+    { "Highpass_Filter",     OBJECT(HighpassObject) },
+    { "Bandpass_Filter",     OBJECT(BandpassObject) },
+    { "Allpass_Filter",      OBJECT(AllpassObject) },
+    { "Convolver",           OBJECT(ConvolveObject) },
+    { "Pole",                OBJECT(PoleObject) },
+    { "Zero",                OBJECT(ZeroObject) },
+};
+#undef OBJECT
+
+
+
+
+static const Symbol n_symbol = intern("n");
+
+// Symbols every program starts out with, and the body of every function
+static const Symbol constant_names[] = { intern("sample_rate"), intern("fs"), intern("tau"), intern("pi"), intern("true"),
+                                         intern("false"), intern("i"), intern("e"), intern("blocksize") };
+
+static TypedValue constant_value(const size_t n, const Graph* const program)
+{
+    switch (n) {
+        case 0: case 1: return get_sample_rate();
+        case 2:         return TAU;
+        case 3:         return TAU / 2.f;
+        case 4:         return 1;
+        case 5:         return 0;
+        case 6:         return Number(0, 1);
+        case 7:         return 2.718281828459045f;
+        default:        return program->get_blocksize();
+    }
+}
+
+static void add_constants(Graph* const program)
+{
+    for (size_t n = 0; n < std::size(constant_names); n++)
+        if (!program->symbol_exists(constant_names[n])) program->add_symbol(constant_names[n], constant_value(n, program));
+}
+
+std::shared_ptr<const std::vector<Statement>> SubgraphRepresentation::body() const
+{
+    return std::shared_ptr<const Block>(declaration, &declaration->body);
+}
+
+bool Evaluator::run(Graph& graph, const std::shared_ptr<const Block>& statements)
+{
+    program = &graph;
+    syntax_tree = statements;
+    add_constants(program);
+
+    try {
+        for (const Statement& statement : *statements) {
+            evaluate(statement);
+            if (hook) hook();
+        }
+    } catch (const VolsungException&) {
+        program->reset();
+        return false;
+    }
+
+    program->compile();
+    return true;
+}
+
+void Evaluator::set_hook(std::function<void()> function)
+{
+    hook = function;
+}
+
+void Evaluator::evaluate(const Statement& statement)
+{
+    line = statement.line;
+
+    switch (statement.kind) {
+        case Statement::Kind::expression:
+            evaluate(*statement.expressions[0]);
+            break;
+
+        case Statement::Kind::symbol_declaration: {
+            const TypedValue value = evaluate(*statement.expressions[0]);
+            program->add_symbol(statement.symbol, value);
+            break;
+        }
+
+        case Statement::Kind::connection:
+            connect(statement);
+            break;
+
+        case Statement::Kind::subgraph_declaration: {
+            const float inputs = evaluate(*statement.expressions[0]).get_value<Number>();
+            const float outputs = evaluate(*statement.expressions[1]).get_value<Number>();
+            const std::shared_ptr<const Statement> declaration(syntax_tree, &statement);
+            program->subgraphs.insert({ statement.symbol, { declaration, { inputs, outputs } } });
+            break;
+        }
+
+        case Statement::Kind::directive:
+            program->invoke_directive(statement.name, evaluate(statement.expressions));
+            break;
+    }
+}
+
+TypedValue Evaluator::evaluate(const Expression& expression)
+{
+    line = expression.line;
+    const auto& operands = expression.operands;
+
+    switch (expression.kind) {
+        case Expression::Kind::literal:
+            return expression.value;
+
+        case Expression::Kind::duration:
+            return (float) expression.value.get_value<Number>() * (get_sample_rate() / expression.divisor);
+
+        case Expression::Kind::identifier:
+            return find_symbol(expression);
+
+        case Expression::Kind::sequence: {
+            Sequence s;
+            s.reserve(operands.size());
+            for (auto const& element : operands) s.add_element(evaluate(*element).get_value<Number>());
+            return s;
+        }
+
+        case Expression::Kind::function:
+            return make_function(expression);
+
+        case Expression::Kind::add:
+        case Expression::Kind::subtract:
+        case Expression::Kind::multiply:
+        case Expression::Kind::divide:
+        case Expression::Kind::power: {
+            TypedValue value = evaluate(*operands[0]);
+            const TypedValue operand = evaluate(*operands[1]);
+
+            switch (expression.kind) {
+                case Expression::Kind::add:      value += operand; break;
+                case Expression::Kind::subtract: value -= operand; break;
+                case Expression::Kind::multiply: value *= operand; break;
+                case Expression::Kind::divide:   value /= operand; break;
+                default:                         value ^= operand; break;
+            }
+            return value;
+        }
+
+        case Expression::Kind::negate:
+            return -evaluate(*operands[0]);
+
+        case Expression::Kind::range: {
+            const float lower = evaluate(*operands[0]).get_value<Number>();
+            const float upper = evaluate(*operands[1]).get_value<Number>();
+            const float step = operands.size() > 2 ? (float) evaluate(*operands[2]).get_value<Number>() : 1.f;
+
+            Sequence s;
+            if (lower > upper) for (float n = lower; n >= upper; n -= step) s.add_element(n);
+            else               for (float n = lower; n <= upper; n += step) s.add_element(n);
+            return s;
+        }
+
+        case Expression::Kind::interpolated_range: {
+            const float lower = evaluate(*operands[0]).get_value<Number>();
+            const float upper = evaluate(*operands[1]).get_value<Number>();
+            const float target = evaluate(*operands[2]).get_value<Number>();
+            const float step_size = (target - lower) / (upper - 1);
+
+            Sequence s;
+            s.reserve(std::max(upper, 0.f));
+            for (size_t n = 0; n < upper; n++)
+                s.add_element(lower + n * step_size);
+            return s;
+        }
+
+        case Expression::Kind::subscript: {
+            const TypedValue value = evaluate(*operands[0]);
+            if (!value.is_type<Sequence>()) error("Attempted to subscript non-sequence");
+            const TypedValue index = evaluate(*operands[1]);
+
+            if (index.is_type<Number>()) {
+                return value.get_value<Sequence>()[(int) index.get_value<Number>()];
+            }
+
+            else if (index.is_type<Sequence>()) {
+                Sequence s;
+                const Sequence& index_sequence = index.get_value<Sequence>();
+                const Sequence& value_sequence = value.get_value<Sequence>();
+                s.reserve(index_sequence.size());
+
+                for (size_t n = 0; n < index_sequence.size(); n++)
+                    s.add_element(value_sequence[(size_t) index_sequence[(size_t) n]]);
+
+                return s;
+            }
+
+            error("Index into sequence must be a number or a sequence");
+            break;
+        }
+
+        case Expression::Kind::call: {
+            const TypedValue procedure = evaluate(*operands[0]);
+            if (!procedure.is_type<Procedure>()) error("Attempted to call non-procedure. Value is: " + procedure.as_string());
+
+            ArgumentList arguments;
+            for (size_t n = 1; n < operands.size(); n++) arguments.push_back(evaluate(*operands[n]));
+            return call(expression, procedure, arguments);
+        }
+
+        case Expression::Kind::method_call: {
+            ArgumentList arguments = { evaluate(*operands[0]) };
+            const TypedValue procedure = evaluate(*operands[1]);
+            for (size_t n = 2; n < operands.size(); n++) arguments.push_back(evaluate(*operands[n]));
+            return call(expression, procedure, arguments);
+        }
+    }
+
+    return 0;
+}
+
+ArgumentList Evaluator::evaluate(const std::vector<std::unique_ptr<Expression>>& expressions)
+{
+    ArgumentList values;
+    for (auto const& expression : expressions) values.push_back(evaluate(*expression));
+    return values;
+}
+
+TypedValue Evaluator::find_symbol(const Expression& identifier)
+{
+    const CallFrame* scope_frame = frame;
+    Program* scope = program;
+
+    for (size_t n = 0; n < identifier.parent_levels; n++) {
+        if (scope_frame) scope_frame = scope_frame->enclosing.get();
+        else if (!scope->parent) error("Attempted to use backtick in top-level program. Only use ` in a subgraph or a function definition");
+        else scope = scope->parent;
+    }
+
+    if (scope_frame) {
+        const std::vector<Symbol>& parameters = *scope_frame->parameters;
+        for (size_t n = 0; n < parameters.size() && n < scope_frame->arguments->size(); n++)
+            if (parameters[n] == identifier.symbol) return (*scope_frame->arguments)[n];
+
+        for (size_t n = 0; n < std::size(constant_names); n++)
+            if (constant_names[n] == identifier.symbol) return constant_value(n, program);
+    }
+
+    else if (scope->symbol_exists(identifier.symbol)) return scope->get_symbol_value(identifier.symbol);
+
+    if (Program::procedures.count(identifier.name)) return Program::procedures.at(identifier.name);
+
+    error("Symbol not found: " + identifier.name);
+    return 0;
+}
+
+TypedValue Evaluator::make_function(const Expression& function)
+{
+    const std::shared_ptr<const Expression> body = function.operands.empty()
+        ? nullptr : std::shared_ptr<const Expression>(syntax_tree, function.operands[0].get());
+    const std::vector<Symbol>* const parameters = &function.parameters;
+    Program* const parent = program;
+
+    std::shared_ptr<const CallFrame> enclosing;
+    if (frame) {
+        auto copy = std::make_shared<CallFrame>(*frame);
+        copy->captured_arguments = *frame->arguments;
+        copy->arguments = &copy->captured_arguments;
+        enclosing = copy;
+    }
+
+    Procedure::Implementation impl = [body, parameters, parent, enclosing] (const ArgumentList& args, Program*) {
+        if (!body) return TypedValue(0);
+
+        const CallFrame call_frame = { parameters, &args, enclosing, { } };
+        Evaluator evaluator;
+        evaluator.program = parent;
+        evaluator.frame = &call_frame;
+        evaluator.syntax_tree = body;
+        return evaluator.evaluate(*body);
+    };
+
+    return Procedure(impl, parameters->size(), parameters->size(), false);
+}
+
+TypedValue Evaluator::call(const Expression& expression, const TypedValue& value, const ArgumentList& arguments)
+{
+    const Procedure procedure = value.get_value<Procedure>();
+    const std::string& name = expression.name;
+
+    if (procedure.max_arguments < arguments.size())
+        Volsung::error("Too many arguments in procedure call to '" + name +"'. Expected " + std::to_string(procedure.max_arguments) +", got " + std::to_string(arguments.size()));
+
+    if (procedure.min_arguments > arguments.size())
+        Volsung::error("Too few arguments in procedure call to '" + name +"'. Expected " + std::to_string(procedure.min_arguments) +", got " + std::to_string(arguments.size()));
+
+    return procedure(arguments, program);
+}
+
+void Evaluator::connect(const Statement& statement)
+{
+    ObjectRange output_object = find_object(statement.object);
+    int output_index = statement.output;
+
+    for (const Connection& connection : statement.connections) {
+        const ObjectRange input_object = find_object(connection.target);
+
+        if (connection.series) {
+            program->expect_to_be_group(input_object);
+            if (!input_object.size) error("Group connected in series has no members");
+            program->connect_objects(output_object, output_index, input_object.member(0), connection.input, connection.type);
+            program->connect_objects(output_object, output_index, input_object, connection.input, ConnectionType::series);
+            output_object = input_object.member(input_object.size - 1);
+        }
+
+        else {
+            program->connect_objects(output_object, output_index, input_object, connection.input, connection.type);
+            output_object = input_object;
+        }
+
+        output_index = connection.output;
+    }
+}
+
+ObjectRange Evaluator::find_object(const ObjectReference& object)
+{
+    line = object.line;
+    if (object.declaration) return declare_object(*object.declaration);
+    Volsung::assert(program->object_exists(object.name), "Undefined object: " + symbol_name(object.name));
+
+    const ObjectRange range = program->find_object(object.name);
+    if (!object.index) return range;
+
+    const int index = (int) evaluate(*object.index).get_value<Number>();
+    program->expect_to_be_group(range);
+    if (index < 0 || (size_t) index >= range.size)
+        error("Index out of range on group '" + symbol_name(object.name) + "'. Index is: " + std::to_string(index));
+    return range.member(index);
+}
+
+ObjectRange Evaluator::declare_object(const ObjectDeclaration& declaration)
+{
+    line = declaration.line;
+
+    if (declaration.count) {
+        const size_t count = (int) evaluate(*declaration.count).get_value<Number>();
+
+        bool n_existed = false;
+        TypedValue old_n;
+        if (program->symbol_exists(n_symbol)) {
+            old_n = program->get_symbol_value(n_symbol);
+            n_existed = true;
+        }
+
+        const size_t first = program->object_count();
+        for (size_t n = 0; n < count; n++) {
+            program->remove_symbol(n_symbol);
+            program->add_symbol(n_symbol, n+1);
+            make_object(declaration.type, unnamed, evaluate(declaration.arguments));
+            program->remove_symbol(n_symbol);
+        }
+
+        if (n_existed) program->add_symbol(n_symbol, old_n);
+        const ObjectRange group = program->create_group(declaration.name, first);
+        program->set_origin(group, declaration.type, declaration.line);
+        return group;
+    }
+
+    if (program->object_exists(declaration.name) && program->find_object(declaration.name).group)
+        error("Object " + symbol_name(declaration.name) + " already exists as group");
+    const ObjectRange object = make_object(declaration.type, declaration.name, evaluate(declaration.arguments));
+    program->set_origin(object, declaration.type, declaration.line);
+    return object;
+}
+
+ObjectRange Evaluator::make_object(const std::string& object_type, const Symbol object_name, const ArgumentList& arguments)
+{
+    if (object_creators.count(object_type))
+        return (program->*(object_creators.at(object_type)))(object_name, arguments);
+
+    const SubgraphRepresentation& subgraph = program->find_subgraph_recursively(intern(object_type));
+
+    const auto io = subgraph.io;
+    ArgumentList parameters = arguments;
+    parameters.insert(parameters.begin(), TypedValue { (Number) io[0] });
+    parameters.insert(parameters.begin() + 1, TypedValue { (Number) io[1] });
+
+    const ObjectRange object = program->create_object<SubgraphObject>(object_name, parameters);
+
+    program->get_audio_object_raw_pointer<SubgraphObject>(object)->graph = std::make_unique<Program>();
+    Program* const other_program = program->get_audio_object_raw_pointer<SubgraphObject>(object)->graph.get();
+
+    Evaluator subgraph_evaluator;
+    other_program->parent = program;
+    other_program->set_blocksize(program->get_blocksize());
+    other_program->configure_io((uint) io[0], (uint) io[1]);
+    other_program->reset();
+
+    for (size_t n = 2; n < parameters.size(); n++)
+        other_program->add_symbol("_" + std::to_string(n-1), parameters[n]);
+
+    if (!subgraph_evaluator.run(*other_program, subgraph.body())) error("Subgraph failed to evaluate");
+    return object;
+}
+
+void Evaluator::error(const std::string& error) const
+{
+    Volsung::error("Line " + std::to_string(line) + ": " + error);
+}
+
+}
@@ -0,0 +1,208 @@
+
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
+
+#include "Executor.hh"
+
+namespace Volsung {
+
+static thread_local bool inside_task = false;
+
+// Each worker has its own queue, and threads from outside the pool share the first one.
+// Threads take work from the back of their own queue, and steal from the front of the others.
+class WorkerPool
+{
+    struct Work
+    {
+        TaskGraph* graph;
+        size_t task;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Work> work;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex workers_mutex;
+
+    std::atomic<size_t> queued { 0 };
+    std::atomic<size_t> sleeping { 0 };
+    std::atomic<bool> stopping { false };
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    static inline thread_local size_t own_queue = 0;
+    static constexpr size_t max_threads = 64;
+    static constexpr size_t spins_before_sleeping = 256;
+
+    bool take(Work& work)
+    {
+        if (!queued.load()) return false;
+
+        for (size_t n = 0; n < queues.size(); n++) {
+            const size_t index = (own_queue + n) % queues.size();
+            Queue& queue = *queues[index];
+            const std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.work.empty()) continue;
+
+            if (index == own_queue) {
+                work = queue.work.back();
+                queue.work.pop_back();
+            }
+            else {
+                work = queue.work.front();
+                queue.work.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void work_until_stopped(const size_t index)
+    {
+        own_queue = index;
+        Work work;
+
+        while (!stopping) {
+            bool found = false;
+            for (size_t n = 0; n < spins_before_sleeping && !found; n++) {
+                found = take(work);
+                if (!found) std::this_thread::yield();
+            }
+
+            if (found) {
+                work.graph->execute(work.task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleeping++;
+            wake.wait(lock, [this] { return queued.load() || stopping; });
+            sleeping--;
+        }
+    }
+
+public:
+    static WorkerPool& instance()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    WorkerPool()
+    {
+        // The queues are made up front, so that workers can be added while others are running
+        for (size_t n = 0; n < max_threads; n++) queues.push_back(std::make_unique<Queue>());
+    }
+
+    ~WorkerPool()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    void ensure_threads(size_t threads)
+    {
+        threads = std::min(threads, max_threads);
+        const std::lock_guard<std::mutex> lock(workers_mutex);
+        while (workers.size() + 1 < threads) {
+            const size_t index = workers.size() + 1;
+            workers.emplace_back([this, index] { work_until_stopped(index); });
+        }
+    }
+
+    void push(TaskGraph* const graph, const size_t task)
+    {
+        {
+            Queue& queue = *queues[own_queue];
+            const std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.work.push_back({ graph, task });
+        }
+        queued++;
+
+        if (sleeping.load()) {
+            const std::lock_guard<std::mutex> lock(sleep_mutex);
+            wake.notify_one();
+        }
+    }
+
+    void help_until_finished(const std::atomic<size_t>& remaining)
+    {
+        Work work;
+        while (remaining.load(std::memory_order_acquire)) {
+            if (take(work)) work.graph->execute(work.task);
+            else std::this_thread::yield();
+        }
+    }
+};
+
+
+TaskGraph::TaskGraph(const std::vector<std::vector<size_t>>& task_successors, const Callback task_callback)
+    : successors(task_successors), dependency_counts(task_successors.size(), 0),
+      pending(new std::atomic<size_t>[task_successors.size()]), callback(task_callback)
+{
+    for (const auto& targets : successors)
+        for (const size_t target : targets)
+            dependency_counts[target]++;
+}
+
+void TaskGraph::run(size_t threads)
+{
+    // More threads than cores would only take turns
+    threads = std::min<size_t>(threads, std::max(std::thread::hardware_concurrency(), 1u));
+
+    if (inside_task || threads <= 1) {
+        for (size_t task = 0; task < successors.size(); task++) callback(task);
+        return;
+    }
+
+    WorkerPool& pool = WorkerPool::instance();
+    pool.ensure_threads(threads);
+
+    for (size_t task = 0; task < successors.size(); task++) pending[task] = dependency_counts[task];
+    remaining = successors.size();
+    failure = nullptr;
+
+    for (size_t task = 0; task < successors.size(); task++)
+        if (!dependency_counts[task]) pool.push(this, task);
+
+    pool.help_until_finished(remaining);
+    if (failure) std::rethrow_exception(failure);
+}
+
+void TaskGraph::execute(const size_t task)
+{
+    // A task that fails still counts as run, so that the rest of the graph isn't held up
+    inside_task = true;
+    try {
+        callback(task);
+    }
+    catch (...) {
+        const std::lock_guard<std::mutex> lock(failure_mutex);
+        if (!failure) failure = std::current_exception();
+    }
+    inside_task = false;
+
+    for (const size_t successor : successors[task])
+        if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            WorkerPool::instance().push(this, successor);
+
+    remaining.fetch_sub(1, std::memory_order_release);
+}
+
+bool TaskGraph::is_inside_task()
+{
+    return inside_task;
+}
+
+}
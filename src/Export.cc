@@ -0,0 +1,314 @@
+
+#include <set>
+#include <sstream>
+#include <cctype>
+
+#include "Graph.hh"
+#include "Objects.hh"
+
+namespace Volsung {
+
+// Functions the code of objects may use, written into the exported file when they are.
+// Each follows the kernel of the same name sample by sample, so that it rounds the same way.
+static const std::map<std::string, std::string> helper_functions = {
+    { "sin_turns", R"(// sin(2πx) for x in turns, as the sine_wave kernel works it out
+inline float sin_turns(const float x)
+{
+    float r = x - ((x + 12582912.f) - 12582912.f);
+    r = r > 0.25f ? 0.5f - r : r;
+    r = r < -0.25f ? -0.5f - r : r;
+    r = r * 6.28318530718f;
+
+    const float r2 = r * r;
+    float p = -2.50521083854e-8f;
+    p = p * r2 + 2.75573192240e-6f;
+    p = p * r2 - 1.98412698413e-4f;
+    p = p * r2 + 8.33333333333e-3f;
+    p = p * r2 - 1.66666666667e-1f;
+    return r + r * r2 * p;
+}
+)" },
+    { "polyblep", R"(// The polynomial band-limited step of the saw_wave and square_wave kernels, with the increment
+// held to half a turn as they hold it
+inline float polyblep(const float t, float increment)
+{
+    increment = increment > 0.5f ? 0.5f : increment;
+    if (t < increment) {
+        const float after = t / increment;
+        return after + after - after * after - 1.f;
+    }
+    if (t > 1.f - increment) {
+        const float before = (t - 1.f) / increment;
+        return before * before + before + before + 1.f;
+    }
+    return 0.f;
+}
+)" },
+};
+
+// Code of each sample is split in three, so that the connections read late can be read before
+// anything else runs, and written once everything has
+struct CodeEmitter
+{
+    std::vector<ObjectCode::Variable> state;
+    std::string block_start;
+    std::string sample_start;
+    std::string sample;
+    std::string sample_end;
+    std::string block_end;
+    std::set<std::string> helpers;
+    size_t objects = 0;
+    size_t connections = 0;
+};
+
+static std::string indent(const std::string& code, const size_t spaces)
+{
+    std::string indented;
+    std::stringstream lines(code);
+    for (std::string line; std::getline(lines, line);)
+        indented += (line.empty() ? "" : std::string(spaces, ' ') + line) + "\n";
+    return indented;
+}
+
+// Expressions are bracketed wherever they are put in, unless they are a single name or number
+static std::string operand(const std::string& expression)
+{
+    if (expression.find(' ') == std::string::npos && expression[0] != '-') return expression;
+    return "(" + expression + ")";
+}
+
+namespace {
+
+struct ObjectNames
+{
+    std::string prefix;
+    std::set<std::string> state;
+    std::set<std::string> arrays;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::string index;
+    std::string length;
+
+    std::string substitute(const std::string& code) const
+    {
+        std::string result;
+        for (size_t n = 0; n < code.size(); n++) {
+            if (code[n] != '$') {
+                result += code[n];
+                continue;
+            }
+
+            size_t end = n + 1;
+            while (end < code.size() && (std::isalnum((unsigned char) code[end]) || code[end] == '_')) end++;
+            const std::string name = code.substr(n + 1, end - n - 1);
+            n = end - 1;
+
+            const auto numbered = [&name] (const std::string& stem) {
+                return name.size() > stem.size() && !name.compare(0, stem.size(), stem)
+                    && name.find_first_not_of("0123456789", stem.size()) == std::string::npos;
+            };
+
+            if (numbered("in")) result += operand(inputs.at(std::stoul(name.substr(2))));
+            else if (numbered("out")) result += outputs.at(std::stoul(name.substr(3)));
+            else if (name == "i") result += index;
+            else if (name == "n") result += length;
+            else if (state.count(name) && !arrays.count(name)) result += "s." + prefix + name;
+            else result += prefix + name;
+        }
+        return result;
+    }
+};
+
+}
+
+void Program::emit_code(CodeEmitter& emitter, const std::vector<std::string>& input_expressions,
+                        std::vector<std::string>& output_expressions)
+{
+    if (schedule_is_stale) compile();
+
+    std::map<const AudioConnector*, std::pair<const AudioObject*, size_t>> producers;
+    for (auto const& object : objects) {
+        for (size_t n = 0; n < object->outputs.size(); n++)
+            for (auto const& connector : object->outputs[n].connections)
+                producers[connector.get()] = { object.get(), n };
+    }
+
+    // Objects in feedback loops run in the sub-blocks of their loop, starting and ending a block
+    // with each, as the interpreter runs them
+    std::map<const AudioObject*, size_t> subblocks;
+    for (const Segment& loop : feedback_loops) {
+        for (size_t position = loop.first; position < loop.last; position++) {
+            for (AudioObject* const object : objects_at(position)) {
+                if (dynamic_cast<SubgraphObject*>(object)) error("Subgraphs in feedback loops can't be exported to C++");
+                subblocks[object] = loop.subblock_length;
+            }
+        }
+    }
+
+    // Connections closing a loop hand on their samples `delay` samples late. Each keeps the samples
+    // it has yet to hand on in a ring, starting with those the interpreter would read next.
+    std::map<std::pair<const AudioObject*, size_t>, std::string> sources;
+    std::vector<std::pair<const AudioConnector*, std::string>> late;
+    const auto read_late = [&] (AudioConnector* const connector) {
+        const std::string prefix = "c" + std::to_string(emitter.connections++) + "_";
+        const size_t delay = connector->delay;
+
+        std::string values;
+        bool silent = true;
+        for (size_t n = 0; n < delay; n++) {
+            float value = 0.f;
+            if (!connector->history.empty()) value = connector->history[connector->history_half * delay + n];
+            else if (connector->stored_buffer.data_pointer()) value = connector->stored_buffer[connector->period - delay + n];
+            values += (n ? ", " : "") + AudioObject::literal(value);
+            silent = silent && value == 0.f;
+        }
+
+        emitter.state.push_back({ "float", prefix + "ring", silent ? "{ }" : "{ " + values + " }", delay });
+        emitter.state.push_back({ "int", prefix + "position", "0" });
+        emitter.sample_start += "const float " + prefix + "out = " + prefix + "ring[s." + prefix + "position];\n";
+        late.push_back({ connector, prefix });
+        return prefix + "out";
+    };
+
+    // Objects that aren't scheduled are constant, and their output is written in as a number
+    const auto input_expression = [&] (const AudioObject* const object, const size_t input) {
+        std::string sum;
+        for (auto const& connector : object->inputs[input].connections) {
+            const auto source = sources.find(producers.at(connector.get()));
+            std::string term = connector->delay ? read_late(connector.get())
+                : source != sources.end() ? source->second : AudioObject::literal(connector->stored_buffer[0]);
+            if (connector->gain != 1.f) term = operand(term) + " * " + AudioObject::literal(connector->gain);
+            sum = sum.empty() ? term : "(" + sum + " + " + term + ")";
+        }
+        return sum.empty() ? "0.f" : sum;
+    };
+
+    for (size_t position = 0; position < schedule.size(); position++) {
+        for (AudioObject* const object : objects_at(position)) {
+            if (dynamic_cast<AudioInputObject*>(object)) {
+                for (size_t n = 0; n < object->outputs.size(); n++)
+                    sources[{ object, n }] = n < input_expressions.size() ? input_expressions[n] : "0.f";
+                continue;
+            }
+
+            if (dynamic_cast<AudioOutputObject*>(object)) continue;
+
+            if (object->is_passing_through()) {
+                sources[{ object, 0 }] = input_expression(object, 0);
+                continue;
+            }
+
+            std::vector<std::string> inputs;
+            for (size_t n = 0; n < object->inputs.size(); n++) inputs.push_back(input_expression(object, n));
+
+            if (auto* const subgraph = dynamic_cast<SubgraphObject*>(object)) {
+                std::vector<std::string> outputs;
+                subgraph->graph->emit_code(emitter, inputs, outputs);
+                for (size_t n = 0; n < object->outputs.size(); n++)
+                    sources[{ object, n }] = n < outputs.size() ? outputs[n] : "0.f";
+                continue;
+            }
+
+            const std::optional<ObjectCode> code = object->generate_code();
+            if (!code) error("Object '" + name_of(object) + "' can't be exported to C++");
+
+            ObjectNames local;
+            local.prefix = "o" + std::to_string(emitter.objects++) + "_";
+            local.inputs = inputs;
+            for (auto const& variable : code->state) {
+                local.state.insert(variable.name);
+                if (variable.length) local.arrays.insert(variable.name);
+                emitter.state.push_back({ variable.type, local.prefix + variable.name, variable.value, variable.length });
+            }
+            emitter.helpers.insert(code->helpers.begin(), code->helpers.end());
+
+            for (size_t n = 0; n < object->outputs.size(); n++) {
+                local.outputs.push_back(local.prefix + "out" + std::to_string(n));
+                sources[{ object, n }] = local.outputs.back();
+                emitter.sample += "float " + local.outputs.back() + ";\n";
+            }
+
+            const auto subblock = subblocks.find(object);
+            if (subblock == subblocks.end()) {
+                local.index = "i";
+                local.length = "n";
+                emitter.block_start += local.substitute(code->block_start);
+                emitter.sample += local.substitute(code->sample);
+                emitter.block_end += local.substitute(code->block_end);
+                continue;
+            }
+
+            const std::string length = std::to_string(subblock->second);
+            local.index = subblock->second == 1 ? "0" : "i % " + length;
+            local.length = length;
+            emitter.block_start += local.substitute(code->block_start);
+            emitter.sample += local.substitute(code->sample);
+            if (subblock->second == 1) emitter.sample += local.substitute(code->block_end);
+            else if (!code->block_end.empty())
+                emitter.sample += "if (i % " + length + " == " + length + " - 1) {\n" + indent(local.substitute(code->block_end), 4) + "}\n";
+        }
+    }
+
+    for (auto const& [connector, prefix] : late) {
+        const std::string ring = prefix + "ring[s." + prefix + "position]";
+        emitter.sample_end += ring + " = " + sources.at(producers.at(connector)) + ";\n"
+                              "if (++s." + prefix + "position == " + std::to_string(connector->delay) + ") s." + prefix + "position = 0;\n";
+    }
+
+    output_expressions.clear();
+    if (object_exists("output")) {
+        const AudioObject* const output = get_audio_object_raw_pointer<AudioObject>("output");
+        for (size_t n = 0; n < output->inputs.size(); n++)
+            output_expressions.push_back(input_expression(output, n));
+    }
+}
+
+std::string Program::emit_cpp()
+{
+    CodeEmitter emitter;
+    std::vector<std::string> input_expressions, output_expressions;
+    for (uint n = 0; n < inputs; n++) input_expressions.push_back("in[" + std::to_string(n) + "][i]");
+    emit_code(emitter, input_expressions, output_expressions);
+
+    for (size_t n = 0; n < output_expressions.size(); n++)
+        emitter.sample += "out[" + std::to_string(n) + "][i] = " + output_expressions[n] + ";\n";
+
+    std::stringstream file;
+    file << "// Exported from a Volsung program. process() runs the program on a block of n samples, with an\n"
+            "// array for each channel in `in` and `out`. Its output is that of the program run in blocks\n"
+            "// of the same length.\n\n"
+            "#include <cmath>\n"
+            "#include <cstdint>\n"
+            "#include <limits>\n"
+            "#include <algorithm>\n"
+            "#include <random>\n\n"
+            "namespace {\n\n";
+
+    for (const std::string& helper : emitter.helpers) file << helper_functions.at(helper) << "\n";
+
+    // Arrays are left out of the state copied in and out of each block
+    file << "struct State\n{\n";
+    for (auto const& variable : emitter.state)
+        if (!variable.length) file << "    " << variable.type << " " << variable.name << " = " << variable.value << ";\n";
+    file << "};\n\n"
+            "State state;\n";
+    for (auto const& variable : emitter.state)
+        if (variable.length) file << variable.type << " " << variable.name << "[" << variable.length << "] = " << variable.value << ";\n";
+    file << "\n"
+            "}\n\n"
+            "void process(float** in, float** out, int n)\n"
+            "{\n"
+            "    (void) in;\n"
+            "    State s = state;\n\n"
+         << indent(emitter.block_start, 4)
+         << "    for (int i = 0; i < n; i++) {\n"
+         << indent(emitter.sample_start + emitter.sample + emitter.sample_end, 8)
+         << "    }\n"
+         << indent(emitter.block_end, 4)
+         << "    state = s;\n"
+            "}\n";
+
+    return file.str();
+}
+
+}
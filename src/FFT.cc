@@ -0,0 +1,283 @@
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "FFT.hh"
+#include "VolsungCore.hh"
+
+namespace Volsung {
+
+static bool is_power_of_two(const size_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+static Complex unit(const double angle)
+{
+    return Complex((float) std::cos(angle), (float) std::sin(angle));
+}
+
+template <class Transform>
+static std::shared_ptr<const Transform> cached_plan(const size_t size)
+{
+    static std::mutex mutex;
+    static std::map<size_t, std::shared_ptr<const Transform>> plans;
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto existing = plans.find(size);
+        if (existing != plans.end()) return existing->second;
+    }
+
+    // Made outside the lock, since plans ask for other plans in turn
+    auto created = std::make_shared<const Transform>(size);
+    const std::lock_guard<std::mutex> lock(mutex);
+    return plans.emplace(size, std::move(created)).first->second;
+}
+
+std::shared_ptr<const FFT> FFT::plan(const size_t size)
+{
+    return cached_plan<FFT>(size);
+}
+
+FFT::FFT(const size_t fft_size) : size(fft_size)
+{
+    Volsung::assert(size > 0, "FFT size must be positive");
+
+    if (!is_power_of_two(size)) {
+        // With chirp[n] = e^(-iπn²/N), X[k] = chirp[k] Σ x[n] chirp[n] conj(chirp[k - n])
+        size_t convolution_size = 1;
+        while (convolution_size < 2 * size - 1) convolution_size *= 2;
+        bluestein_plan = plan(convolution_size);
+
+        chirp.resize(size);
+        for (size_t n = 0; n < size; n++) {
+            // n² is reduced modulo 2N first, so that the angle stays accurate for large n
+            const unsigned long long square = (unsigned long long) n * n % (2 * size);
+            chirp[n] = unit(-M_PI * double(square) / double(size));
+        }
+
+        chirp_spectrum.assign(convolution_size, Complex(0.f, 0.f));
+        const float scale = 1.f / float(convolution_size);
+        chirp_spectrum[0] = std::conj(chirp[0]) * scale;
+        for (size_t n = 1; n < size; n++) {
+            chirp_spectrum[n] = chirp_spectrum[convolution_size - n] = std::conj(chirp[n]) * scale;
+        }
+        bluestein_plan->forward(chirp_spectrum.data());
+        return;
+    }
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size) bits++;
+
+    bit_reversal.resize(size);
+    for (size_t n = 0; n < size; n++) {
+        std::uint32_t reversed = 0;
+        for (size_t bit = 0; bit < bits; bit++) {
+            if (n & (size_t(1) << bit)) reversed |= std::uint32_t(1) << (bits - 1 - bit);
+        }
+        bit_reversal[n] = reversed;
+    }
+
+    // Each radix-4 pass over groups of 4h uses W^k and W^2k of the 4h-point transform, for k < h,
+    // stored next to each other in the order the passes use them
+    for (size_t h = bits % 2 ? 2 : 1; 4 * h <= size; h *= 4) {
+        for (size_t k = 0; k < h; k++) {
+            twiddles.push_back(unit(-2.0 * M_PI * double(k) / double(4 * h)));
+            twiddles.push_back(unit(-2.0 * M_PI * double(2 * k) / double(4 * h)));
+        }
+    }
+}
+
+template <bool inverse>
+void FFT::transform(Complex* const data) const
+{
+    for (size_t n = 0; n < size; n++) {
+        if (n < bit_reversal[n]) std::swap(data[n], data[bit_reversal[n]]);
+    }
+
+    // std::complex is laid out as an array of two floats, and working on those directly
+    // keeps the butterflies in registers
+    float* const values = reinterpret_cast<float*>(data);
+    const float* factors = reinterpret_cast<const float*>(twiddles.data());
+    const float sign = inverse ? -1.f : 1.f;
+
+    size_t h = 1;
+    if (__builtin_ctzll(size) % 2) {
+        for (size_t n = 0; n < 2 * size; n += 4) {
+            const float a_real = values[n], a_imag = values[n + 1];
+            const float b_real = values[n + 2], b_imag = values[n + 3];
+            values[n] = a_real + b_real;
+            values[n + 1] = a_imag + b_imag;
+            values[n + 2] = a_real - b_real;
+            values[n + 3] = a_imag - b_imag;
+        }
+        h = 2;
+    }
+
+    // Two radix-2 passes at once: the first combines (a, b) and (c, d) with W^2k, the second
+    // combines the results with W^k, and W^(k+h) = -i W^k
+    for (; 4 * h <= size; h *= 4) {
+        for (size_t start = 0; start < size; start += 4 * h) {
+            float* const a = values + 2 * start;
+            float* const b = a + 2 * h;
+            float* const c = b + 2 * h;
+            float* const d = c + 2 * h;
+
+            for (size_t k = 0; k < h; k++) {
+                const float t_real = factors[4 * k], t_imag = sign * factors[4 * k + 1];
+                const float u_real = factors[4 * k + 2], u_imag = sign * factors[4 * k + 3];
+
+                const float a_real = a[2 * k], a_imag = a[2 * k + 1];
+                const float c_real = c[2 * k], c_imag = c[2 * k + 1];
+                const float b_real = b[2 * k] * u_real - b[2 * k + 1] * u_imag;
+                const float b_imag = b[2 * k] * u_imag + b[2 * k + 1] * u_real;
+                const float d_real = d[2 * k] * u_real - d[2 * k + 1] * u_imag;
+                const float d_imag = d[2 * k] * u_imag + d[2 * k + 1] * u_real;
+
+                const float sum_real = a_real + b_real, sum_imag = a_imag + b_imag;
+                const float difference_real = a_real - b_real, difference_imag = a_imag - b_imag;
+
+                const float cd_sum_real = c_real + d_real, cd_sum_imag = c_imag + d_imag;
+                const float cd_difference_real = c_real - d_real, cd_difference_imag = c_imag - d_imag;
+
+                const float s_real = cd_sum_real * t_real - cd_sum_imag * t_imag;
+                const float s_imag = cd_sum_real * t_imag + cd_sum_imag * t_real;
+
+                // Multiplied by W^k, then rotated by -i (or i for the inverse)
+                const float r_real = cd_difference_real * t_real - cd_difference_imag * t_imag;
+                const float r_imag = cd_difference_real * t_imag + cd_difference_imag * t_real;
+                const float rotated_real = sign * r_imag;
+                const float rotated_imag = -sign * r_real;
+
+                a[2 * k] = sum_real + s_real;
+                a[2 * k + 1] = sum_imag + s_imag;
+                c[2 * k] = sum_real - s_real;
+                c[2 * k + 1] = sum_imag - s_imag;
+                b[2 * k] = difference_real + rotated_real;
+                b[2 * k + 1] = difference_imag + rotated_imag;
+                d[2 * k] = difference_real - rotated_real;
+                d[2 * k + 1] = difference_imag - rotated_imag;
+            }
+        }
+        factors += 4 * h;
+    }
+}
+
+void FFT::transform_bluestein(Complex* const data) const
+{
+    std::vector<Complex> buffer(bluestein_plan->get_size(), Complex(0.f, 0.f));
+    for (size_t n = 0; n < size; n++) buffer[n] = data[n] * chirp[n];
+
+    bluestein_plan->forward(buffer.data());
+    for (size_t k = 0; k < buffer.size(); k++) buffer[k] *= chirp_spectrum[k];
+    bluestein_plan->inverse(buffer.data());
+
+    for (size_t k = 0; k < size; k++) data[k] = buffer[k] * chirp[k];
+}
+
+void FFT::forward(Complex* const data) const
+{
+    if (bluestein_plan) transform_bluestein(data);
+    else transform<false>(data);
+}
+
+void FFT::inverse(Complex* const data) const
+{
+    if (bluestein_plan) {
+        // The inverse transform is the conjugate of the forward transform of the conjugate
+        for (size_t n = 0; n < size; n++) data[n] = std::conj(data[n]);
+        transform_bluestein(data);
+        for (size_t n = 0; n < size; n++) data[n] = std::conj(data[n]);
+    }
+    else transform<true>(data);
+}
+
+size_t FFT::get_size() const
+{
+    return size;
+}
+
+
+std::shared_ptr<const RealFFT> RealFFT::plan(const size_t size)
+{
+    return cached_plan<RealFFT>(size);
+}
+
+RealFFT::RealFFT(const size_t fft_size) : size(fft_size)
+{
+    Volsung::assert(size >= 2 && size % 2 == 0, "Real FFT size must be even");
+
+    half = FFT::plan(size / 2);
+    twiddles.resize(size / 2);
+    for (size_t k = 0; k < size / 2; k++) {
+        twiddles[k] = unit(-2.0 * M_PI * double(k) / double(size));
+    }
+}
+
+// The even and odd samples are packed into the real and imaginary parts of a half size signal.
+// With Z its spectrum, and m = N/2 - k, their spectra are E[k] = (Z[k] + conj(Z[m])) / 2 and
+// O[k] = (Z[k] - conj(Z[m])) / 2i, and X[k] = E[k] + W^k O[k], X[m] = conj(E[k] - W^k O[k])
+void RealFFT::forward(const float* const input, Complex* const output) const
+{
+    const size_t half_size = size / 2;
+    for (size_t n = 0; n < half_size; n++) output[n] = Complex(input[2 * n], input[2 * n + 1]);
+    half->forward(output);
+
+    const Complex first = output[0];
+    output[0] = Complex(first.real() + first.imag(), 0.f);
+    output[half_size] = Complex(first.real() - first.imag(), 0.f);
+
+    for (size_t k = 1; 2 * k <= half_size; k++) {
+        const size_t m = half_size - k;
+        const Complex z_k = output[k];
+        const Complex z_m = output[m];
+
+        const Complex even = (z_k + std::conj(z_m)) * 0.5f;
+        const Complex difference = (z_k - std::conj(z_m)) * 0.5f;
+        const Complex odd(difference.imag(), -difference.real());
+        const Complex rotated = twiddles[k] * odd;
+
+        output[k] = even + rotated;
+        output[m] = std::conj(even - rotated);
+    }
+}
+
+// The reverse of the above, scaled so that a round trip multiplies by N like the complex FFT
+void RealFFT::inverse(Complex* const spectrum, float* const output) const
+{
+    const size_t half_size = size / 2;
+
+    const float dc = spectrum[0].real();
+    const float nyquist = spectrum[half_size].real();
+    spectrum[0] = Complex(dc + nyquist, dc - nyquist);
+
+    for (size_t k = 1; 2 * k <= half_size; k++) {
+        const size_t m = half_size - k;
+        const Complex x_k = spectrum[k];
+        const Complex x_m = spectrum[m];
+
+        const Complex even = x_k + std::conj(x_m);
+        const Complex odd = (x_k - std::conj(x_m)) * std::conj(twiddles[k]);
+        const Complex i_odd(-odd.imag(), odd.real());
+        const Complex i_conj_odd(odd.imag(), odd.real());
+
+        spectrum[k] = even + i_odd;
+        spectrum[m] = std::conj(even) + i_conj_odd;
+    }
+
+    half->inverse(spectrum);
+    for (size_t n = 0; n < half_size; n++) {
+        output[2 * n] = spectrum[n].real();
+        output[2 * n + 1] = spectrum[n].imag();
+    }
+}
+
+size_t RealFFT::get_size() const
+{
+    return size;
+}
+
+}
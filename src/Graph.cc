@@ -7,13 +7,23 @@
 #include <string>
 #include <fstream>
 #include <map>
+#include <algorithm>
+#include <set>
+#include <queue>
+#include <limits>
+#include <optional>
 
 #include "Parser.hh"
 #include "Graph.hh"
 #include "Objects.hh"
+#include "FFT.hh"
+#include "Kernels.hh"
 
 namespace Volsung {
 
+static const Symbol input_symbol = intern("input");
+static const Symbol output_symbol = intern("output");
+
 Number::operator float&()
 {
     return real_part;
@@ -85,6 +95,27 @@ Number::Number(float initial_real_part, float initial_imag_part)
       imag_part(initial_imag_part) {}
 
 
+// Arithmetic between real operands runs over the real parts on the kernels, as `x op y` for each
+// element x. Powers, and complex operands, are worked out an element at a time as Numbers.
+using Operation = std::optional<ElementwiseOperation::Kind>;
+static constexpr Operation add_kernel = ElementwiseOperation::Kind::add;
+static constexpr Operation subtract_kernel = ElementwiseOperation::Kind::subtract;
+static constexpr Operation multiply_kernel = ElementwiseOperation::Kind::multiply;
+static constexpr Operation divide_kernel = ElementwiseOperation::Kind::divide;
+static constexpr Operation exponentiate_kernel = std::nullopt;
+
+// `y op x` for each element x of a real sequence, where it can be put in terms of the kernels
+static bool apply_reversed(const Operation kernel, Sequence& sequence, const float y)
+{
+    using Kind = ElementwiseOperation::Kind;
+    if (kernel == Kind::add || kernel == Kind::multiply)
+        elementwise_chain(sequence.real_data(), sequence.real_data(), { { *kernel, y } }, sequence.size());
+    else if (kernel == Kind::subtract)
+        elementwise_chain(sequence.real_data(), sequence.real_data(), { { Kind::negate }, { Kind::add, y } }, sequence.size());
+    else return false;
+    return true;
+}
+
 #define DEFINE_ARITHMETIC_OPERATION_ON_NUMBER(op)                               \
 TypedValue Number::op(const TypedValue& other)                                  \
 {                                                                               \
@@ -92,7 +123,9 @@ TypedValue Number::op(const TypedValue& other)
         case (Type::number): return op##_num(other.get_value<Number>());        \
         case (Type::sequence): {                                                \
             Sequence seq = other.get_value<Sequence>();                         \
-            for (auto& element: seq) element = op##_num(element);               \
+            if (!is_complex() && !seq.is_complex()                              \
+                && apply_reversed(op##_kernel, seq, real_part)) return seq;     \
+            for (size_t n = 0; n < seq.size(); n++) seq.set(n, op##_num(seq[n])); \
             return seq;                                                         \
         }                                                                       \
         default: error("Attempted to perform arithmetic on non-numeric value"); \
@@ -113,15 +146,18 @@ TypedValue Sequence::op(const TypedValue& other)
     switch (other.get_type()) {                                                 \
         case (Type::number): {                                                  \
             const Number value = other.get_value<Number>();                     \
-            for (auto& element: *this) element = element.op##_num(value);       \
+            if (op##_kernel && !is_complex() && !value.is_complex())            \
+                elementwise_chain(real_data(), real_data(), { { *op##_kernel, (float) value } }, size()); \
+            else for (size_t n = 0; n < size(); n++) set(n, (*this)[n].op##_num(value)); \
             return *this;                                                       \
         }                                                                       \
         case (Type::sequence): {                                                \
-            Sequence seq = other.get_value<Sequence>();                         \
+            const Sequence& seq = other.get_value<Sequence>();                  \
             Volsung::assert(size() == seq.size(), "Attempted to perform arithmetic on sequences of inequal length");       \
-            for (size_t n = 0; n < size(); n++)                                 \
-                seq[n] = data[n].op##_num(seq[n]);                              \
-            return seq;                                                         \
+            if (op##_kernel && !is_complex() && !seq.is_complex())              \
+                elementwise_chain(real_data(), real_data(), { { *op##_kernel, 0.f, seq.real_data() } }, size()); \
+            else for (size_t n = 0; n < size(); n++) set(n, (*this)[n].op##_num(seq[n])); \
+            return *this;                                                       \
         }                                                                       \
         default: error("Attempted to perform arithmetic on non-numeric value"); \
     }                                                                           \
@@ -176,17 +212,28 @@ Number Number::exponentiate_num(const Number& other) const
     return Number(complex.real(), complex.imag());
 }
 
+Sequence::Elements& Sequence::unique_elements()
+{
+    if (elements.use_count() > 1) elements = std::make_shared<Elements>(*elements);
+    return *elements;
+}
+
 size_t Sequence::size() const
 {
-    return data.size();
+    return elements->reals.size();
+}
+
+bool Sequence::is_complex() const
+{
+    return !elements->imags.empty();
 }
 
 Sequence::operator Text() const
 {
     std::string string = "{ ";
 
-    if (data.size()) string += (std::string) (Text) data[0];
-    for (size_t n = 1; n < size(); n++) string += ", " + (std::string) (Text) data[n];
+    if (size()) string += (std::string) (Text) (*this)[0];
+    for (size_t n = 1; n < size(); n++) string += ", " + (std::string) (Text) (*this)[n];
     string += " }";
 
     return Text(string);
@@ -194,7 +241,18 @@ Sequence::operator Text() const
 
 void Sequence::add_element(const Number value)
 {
-    data.push_back(value);
+    Elements& data = unique_elements();
+    data.reals.push_back(value);
+    if (!data.imags.empty()) data.imags.push_back(Number(value).imag());
+    else if (value.is_complex()) {
+        data.imags.resize(data.reals.size());
+        data.imags.back() = Number(value).imag();
+    }
+}
+
+void Sequence::reserve(const size_t length)
+{
+    unique_elements().reals.reserve(length);
 }
 
 void Sequence::perform_range_check(const long long n) const
@@ -203,34 +261,54 @@ void Sequence::perform_range_check(const long long n) const
         error("Sequence index out of range. Index is: " + std::to_string(n) + ", length is: " + std::to_string(size()));
 }
 
-Number* Sequence::get_data_pointer()
+float* Sequence::real_data()
 {
-    return data.data();
+    return unique_elements().reals.data();
 }
 
-Number& Sequence::operator[](long long n)
+const float* Sequence::real_data() const
+{
+    return elements->reals.data();
+}
+
+const float* Sequence::imag_data() const
+{
+    return is_complex() ? elements->imags.data() : nullptr;
+}
+
+const Number Sequence::operator[](long long n) const
 {
     if (n < 0) n += size();
     perform_range_check(n);
-    return data[n];
+    return Number(elements->reals[n], is_complex() ? elements->imags[n] : 0.f);
 }
 
-const Number& Sequence::operator[](long long n) const
+void Sequence::set(long long n, const Number value)
 {
     if (n < 0) n += size();
     perform_range_check(n);
-    return data.at(n);
+
+    Elements& data = unique_elements();
+    data.reals[n] = value;
+    if (value.is_complex() && data.imags.empty()) data.imags.resize(data.reals.size());
+    if (!data.imags.empty()) data.imags[n] = Number(value).imag();
 }
 
-// Sequence::Sequence() : identifier(sequence_table.size())
-// {
-//    
-// }
+void Sequence::negate()
+{
+    Elements& data = unique_elements();
+    elementwise_chain(data.reals.data(), data.reals.data(), { { ElementwiseOperation::Kind::negate } }, data.reals.size());
+    if (!data.imags.empty()) elementwise_chain(data.imags.data(), data.imags.data(), { { ElementwiseOperation::Kind::negate } }, data.imags.size());
+}
 
-Sequence::Sequence(const std::vector<float>& _data)
+Sequence::Sequence()
+    : elements(std::make_shared<Elements>())
+{ }
+
+Sequence::Sequence(std::vector<float> real_parts, std::vector<float> imag_parts)
+    : elements(std::make_shared<Elements>(Elements { std::move(real_parts), std::move(imag_parts) }))
 {
-    data.resize(_data.size());
-    for (size_t n = 0; n < _data.size(); n++) data[n] = _data[n];
+    if (is_complex()) Volsung::assert(elements->imags.size() == elements->reals.size(), "Internal error: sequence has mismatched parts");
 }
 
 Type TypedValue::get_type() const
@@ -302,7 +380,7 @@ TypedValue& TypedValue::operator-()
 {
     switch(get_type()) {
         case(Type::number): *this = this->get_value<Number>().negated(); break;
-        case(Type::sequence): for (auto& value: this->get_value<Sequence>()) value = -value; break;
+        case(Type::sequence): this->get_value<Sequence>().negate(); break;
         default: error("Attempted to perform arithmetic on non-numeric value");
     }
     return *this;
@@ -314,28 +392,79 @@ TypedValue Procedure::operator()(const ArgumentList& args, Program* program) con
     Volsung::assert((bool) implementation, "Internal error: procedure has no implementation");
 
     if (can_be_mapped && args.size() && args[0].is_type<Sequence>()) {
-        auto sequence = args[0].get_value<Sequence>();
-        auto parameters = args;
+        const Sequence& sequence = args[0].get_value<Sequence>();
+
+        if (sequence_kernel && args.size() == 1 && !sequence.is_complex()) {
+            std::vector<float> result(sequence.size());
+            sequence_kernel(result.data(), sequence.real_data(), sequence.size(), program && program->uses_fast_math());
+            return Sequence(std::move(result));
+        }
 
+        // The sequence is shared rather than copied, and its place is taken by each element in turn
+        ArgumentList parameters = args;
+
+        Sequence mapped;
+        mapped.reserve(sequence.size());
         for (size_t n = 0; n < sequence.size(); n++) {
             parameters[0] = sequence[n];
-            sequence[n] = implementation(parameters, program).get_value<Number>();
+            mapped.add_element(implementation(parameters, program).get_value<Number>());
         }
-        return sequence;
+        return mapped;
     }
     return implementation(args, program);
 }
 
-Procedure::Procedure(Implementation impl, size_t min_args, size_t max_args, bool _can_be_mapped)
-    : implementation(impl), min_arguments(min_args), max_arguments(max_args), can_be_mapped(_can_be_mapped)
+Procedure::Procedure(Implementation impl, size_t min_args, size_t max_args, bool _can_be_mapped, SequenceKernel kernel)
+    : implementation(impl), min_arguments(min_args), max_arguments(max_args), can_be_mapped(_can_be_mapped),
+      sequence_kernel(kernel)
 { }
 
+// The spectrum of a sequence, or of its real parts only. Real signals of even length go
+// through the real FFT, and the upper half of their spectrum is filled in by symmetry
+static std::vector<Complex> transform_sequence(const Sequence& data, const bool real_parts_only)
+{
+    const size_t size = data.size();
+    std::vector<Complex> spectrum(size);
+    if (!size) return spectrum;
+
+    const bool is_real = real_parts_only || !data.is_complex()
+        || std::all_of(data.imag_data(), data.imag_data() + size, [] (const float x) { return x == 0.f; });
+
+    if (is_real && size % 2 == 0) {
+        std::vector<float> samples(size);
+        std::copy_n(data.real_data(), size, samples.data());
+
+        RealFFT::plan(size)->forward(samples.data(), spectrum.data());
+        for (size_t k = size / 2 + 1; k < size; k++) spectrum[k] = std::conj(spectrum[size - k]);
+        return spectrum;
+    }
+
+    for (size_t n = 0; n < size; n++) {
+        spectrum[n] = Complex(data.real_data()[n], data.imag_data()[n]);
+    }
+    FFT::plan(size)->forward(spectrum.data());
+    return spectrum;
+}
+
 #define APPLY_FLOAT_FUNCTION_TO_NUMBER(fun)      \
     Number number = args[0].get_value<Number>(); \
     number.imag() = fun(number.imag());          \
     number.real() = fun(number.real());          \
     return number                                \
 
+// Kernels for procedures of one number, run over the whole of a real sequence at once. Those with
+// a fast approximation use it when the program uses fast maths.
+#define APPLY_FLOAT_FUNCTION_TO_SEQUENCE(fun)                                                      \
+    [] (float* const out, const float* const in, const size_t length, const bool) {                \
+        for (size_t n = 0; n < length; n++) out[n] = fun(in[n]);                                   \
+    }                                                                                              \
+
+#define APPLY_FAST_FUNCTION_TO_SEQUENCE(fun, fast_fun)                                             \
+    [] (float* const out, const float* const in, const size_t length, const bool fast) {           \
+        if (fast) fast_fun(out, in, length);                                                       \
+        else for (size_t n = 0; n < length; n++) out[n] = fun(in[n]);                              \
+    }                                                                                              \
+
 const SymbolTable<Procedure> Program::procedures = {
     { "random", Procedure([] (const ArgumentList& arguments, Program*) -> TypedValue {
         float min = 0.f;
@@ -348,7 +477,7 @@ const SymbolTable<Procedure> Program::procedures = {
         }
 
         std::uniform_real_distribution<float> distribution(min, max);
-        static std::default_random_engine generator((uint) std::chrono::system_clock::now().time_since_epoch().count());
+        static thread_local std::default_random_engine generator((uint) std::chrono::system_clock::now().time_since_epoch().count());
 
         return (Number) distribution(generator);
     }, 0, 2) },
@@ -359,7 +488,9 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "abs", Procedure([] (const ArgumentList& args, Program*) {
         return args[0].get_value<Number>().magnitude();
-    }, 1, 1, true)},
+    }, 1, 1, true, [] (float* const out, const float* const in, const size_t length, const bool) {
+        absolute(out, in, length);
+    })},
 
     { "mod", Procedure([] (const ArgumentList& args, Program*) {
         Number lhs = args[0].get_value<Number>();
@@ -369,27 +500,27 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "sin", Procedure([] (const ArgumentList& args, Program*) {
         return std::sin(args[0].get_value<Number>());
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FAST_FUNCTION_TO_SEQUENCE(std::sin, fast_sin))},
 
     { "cos", Procedure([] (const ArgumentList& args, Program*) {
         return std::cos(args[0].get_value<Number>());
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FAST_FUNCTION_TO_SEQUENCE(std::cos, fast_cos))},
 
     { "ceil", Procedure([] (const ArgumentList& args, Program*) {
         APPLY_FLOAT_FUNCTION_TO_NUMBER(std::ceil);
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FLOAT_FUNCTION_TO_SEQUENCE(std::ceil))},
 
     { "tanh", Procedure([] (const ArgumentList& args, Program*) {
         APPLY_FLOAT_FUNCTION_TO_NUMBER(std::tanh);
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FAST_FUNCTION_TO_SEQUENCE(std::tanh, fast_tanh))},
 
     { "atan", Procedure([] (const ArgumentList& args, Program*) {
         APPLY_FLOAT_FUNCTION_TO_NUMBER(std::atan);
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FAST_FUNCTION_TO_SEQUENCE(std::atan, fast_atan))},
 
     { "floor", Procedure([] (const ArgumentList& args, Program*) {
         APPLY_FLOAT_FUNCTION_TO_NUMBER(std::floor);
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FLOAT_FUNCTION_TO_SEQUENCE(std::floor))},
 
     { "sign", Procedure([] (const ArgumentList& args, Program*) {
         return float(args[0].get_value<Number>()) >= 0.f ? 1 : -1;
@@ -405,7 +536,7 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "ln", Procedure([] (const ArgumentList& args, Program*) {
         return std::log(args[0].get_value<Number>());
-    }, 1, 1, true)},
+    }, 1, 1, true, APPLY_FAST_FUNCTION_TO_SEQUENCE(std::log, fast_log))},
 
     { "log", Procedure([] (const ArgumentList& args, Program*) {
         float base = 10.f;
@@ -430,8 +561,9 @@ const SymbolTable<Procedure> Program::procedures = {
     }, 1, 1, true)},
 
     { "reverse", Procedure([] (const ArgumentList& args, Program*) {
-        const Sequence source = args[0].get_value<Sequence>();
+        const Sequence& source = args[0].get_value<Sequence>();
         Sequence reverse;
+        reverse.reserve(source.size());
         for (size_t n = 1; n <= source.size(); n++) {
             reverse.add_element(source[source.size() - n]);
         }
@@ -440,10 +572,11 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "concatenate", Procedure([] (const ArgumentList& args, Program*) -> TypedValue {
         if (args[0].is_type<Sequence>()) {
-            const Sequence a = args[0].get_value<Sequence>();
-            const Sequence b = args[1].get_value<Sequence>();
+            const Sequence& a = args[0].get_value<Sequence>();
+            const Sequence& b = args[1].get_value<Sequence>();
 
             Sequence out;
+            out.reserve(a.size() + b.size());
             for (size_t n = 0; n < a.size() + b.size(); n++) {
                 out.add_element(n < a.size() ? a[n] : b[n-a.size()]);
             }
@@ -458,34 +591,30 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "map", Procedure([] (const ArgumentList& args, Program* program) {
         const Procedure proc = args[1].get_value<Procedure>();
-        const Sequence source = args[0].get_value<Sequence>();
+        const Sequence& source = args[0].get_value<Sequence>();
         Sequence mapped;
+        mapped.reserve(source.size());
+        ArgumentList arguments(2);
         for (size_t n = 0; n < source.size(); n++) {
-            mapped.add_element(proc(ArgumentList { source[n], n }, program).get_value<Number>());
+            arguments[0] = source[n];
+            arguments[1] = n;
+            mapped.add_element(proc(arguments, program).get_value<Number>());
         }
         return mapped;
     }, 2, 2)},
 
     { "sum", Procedure([] (const ArgumentList& args, Program*) {
-        Number sum = 0.f;
-        Sequence sequence = args[0].get_value<Sequence>();
-        for (auto element: sequence) {
-            sum += element;
-        }
-        return sum;
+        const Sequence& sequence = args[0].get_value<Sequence>();
+        return (Number) sum(sequence.real_data(), sequence.size());
     }, 1, 1)},
 
     { "average", Procedure([] (const ArgumentList& args, Program*) {
-        Number sum = 0.f;
-        Sequence sequence = args[0].get_value<Sequence>();
-        for (auto element: sequence) {
-            sum += element;
-        }
-        return sum / sequence.size();
+        const Sequence& sequence = args[0].get_value<Sequence>();
+        return (Number) (sum(sequence.real_data(), sequence.size()) / sequence.size());
     }, 1, 1)},
 
     { "greatest", Procedure([] (const ArgumentList& args, Program*) {
-        Sequence sequence = args[0].get_value<Sequence>();
+        const Sequence& sequence = args[0].get_value<Sequence>();
         Number greatest = sequence[0];
         for (size_t n = 0; n < sequence.size(); n++) {
             if (sequence[n].magnitude() > greatest.magnitude()) {
@@ -496,7 +625,7 @@ const SymbolTable<Procedure> Program::procedures = {
     }, 1, 1)},
 
     { "smallest", Procedure([] (const ArgumentList& args, Program*) {
-        Sequence sequence = args[0].get_value<Sequence>();
+        const Sequence& sequence = args[0].get_value<Sequence>();
         Number smallest = sequence[0];
         for (size_t n = 0; n < sequence.size(); n++) {
             if (sequence[n].magnitude() < smallest.magnitude()) {
@@ -533,16 +662,15 @@ const SymbolTable<Procedure> Program::procedures = {
             file.read(reinterpret_cast<char*>(out_data.data()), out_data.size() * sizeof(float));
         }
         else error("Could not read file, not found: '" + filename + "'");
-        return (Sequence) out_data;
+        return Sequence(std::move(out_data));
     }, 1, 1)},
 
     { "write_file", Procedure([](const ArgumentList& args, Program*) {
-        const Sequence in_data = args[1].get_value<Sequence>();
+        const Sequence& in_data = args[1].get_value<Sequence>();
         const std::string filename = args[0].get_value<Text>();
 
         std::ofstream file(filename, std::fstream::out | std::fstream::binary);
-        for (size_t n = 0; n < in_data.size(); n++)
-            file.write((const char*) &in_data[n], sizeof (float));
+        file.write((const char*) in_data.real_data(), in_data.size() * sizeof (float));
 
         file.close();
         return Number(0);
@@ -550,20 +678,22 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "implementation_of", Procedure([] (const ArgumentList& args, Program* program) {
         const std::string object_type = args[0].get_value<Text>();
-        if (!program->subgraphs.count(object_type))
+        const auto subgraph = program->subgraphs.find(intern(object_type));
+        if (subgraph == program->subgraphs.end())
             error("'implementation_of(" + object_type + ")': Subgraph implementation not found");
 
-        return (Text) program->subgraphs.at(object_type).first;
+        return (Text) subgraph->second.declaration->text;
     }, 1, 1)},
 
     { "repeat", Procedure([] (const ArgumentList& args, Program*) {
-        Sequence sequence        = args[0].get_value<Sequence>();
+        const Sequence& sequence = args[0].get_value<Sequence>();
         const size_t num_repeats = args[1].get_value<Number>();
         Sequence output;
+        output.reserve(sequence.size() * num_repeats);
 
         for (size_t n = 0; n < num_repeats; n++) {
-            for (const auto element: sequence) {
-                output.add_element(element);
+            for (size_t element = 0; element < sequence.size(); element++) {
+                output.add_element(sequence[element]);
             }
         }
 
@@ -575,7 +705,7 @@ const SymbolTable<Procedure> Program::procedures = {
         int num_nodes = 0;
 
         while (true) {
-            num_nodes += current_program->table.size();
+            num_nodes += current_program->objects.size();
             if (current_program->parent) current_program = current_program->parent;
             else break;
         }
@@ -607,18 +737,22 @@ const SymbolTable<Procedure> Program::procedures = {
 
     { "run_subgraph", Procedure([] (const ArgumentList& args, Program* program) {
         Graph meta_graph;
-        Parser parser;
+        Evaluator evaluator;
+
+        const std::string object_type = args[0].get_value<Text>();
+        const auto subgraph = program->subgraphs.find(intern(object_type));
+        if (subgraph == program->subgraphs.end())
+            error("'run_subgraph(" + object_type + ")': Subgraph implementation not found");
 
-        const SubgraphRepresentation& subgraph_rep = program->subgraphs[args[0].get_value<Text>()];
+        const SubgraphRepresentation& subgraph_rep = subgraph->second;
         const float sample_count = args[1].get_value<Number>();
-        parser.source_code = subgraph_rep.first;
 
-        meta_graph.configure_io(subgraph_rep.second[0], subgraph_rep.second[1]);
+        meta_graph.configure_io(subgraph_rep.io[0], subgraph_rep.io[1]);
         meta_graph.reset();
-        parser.parse_program(meta_graph);
+        evaluator.run(meta_graph, subgraph_rep.body());
 
         Sequence ret;
-        for (size_t n = 0; n < sample_count / AudioBuffer::blocksize; n++) {
+        for (size_t n = 0; n < sample_count / meta_graph.get_blocksize(); n++) {
             auto data = meta_graph.run();
             for (auto const value: data[0]) {
                 if (ret.size() >= sample_count) break;
@@ -629,131 +763,166 @@ const SymbolTable<Procedure> Program::procedures = {
     }, 2, 2)},
 
     { "DFT", Procedure([] (const ArgumentList& args, Program*) {
-        Sequence data = args[0].get_value<Sequence>();
-        Sequence ret;
+        const Sequence& data = args[0].get_value<Sequence>();
+        const std::vector<Complex> spectrum = transform_sequence(data, true);
 
-        for (size_t n = 0; n < data.size(); n++)
-        {
-            Number complex;
-            for (size_t s = 0; s < data.size(); s++)
-            {
-                float real = data[s] * std::sin(TAU * s * n / data.size());
-                float imag = data[s] * std::cos(TAU * s * n / data.size()) * -1.f;
-    
-                complex = complex.add_num(Number(real, imag));
-            }
-            complex = complex.divide_num(Number(data.size(), 0));
-            ret.add_element(complex);
+        // Kept as it always was: the spectrum of the real parts, rotated by -90° and conjugated
+        Sequence ret;
+        ret.reserve(spectrum.size());
+        for (const Complex& bin: spectrum) {
+            ret.add_element(Number(-bin.imag() / data.size(), -bin.real() / data.size()));
         }
-
         return ret;
     }, 1, 1)},
 
     { "FFT", Procedure([] (const ArgumentList& args, Program*) {
-        Sequence data = args[0].get_value<Sequence>();
+        const Sequence& data = args[0].get_value<Sequence>();
+        const std::vector<Complex> spectrum = transform_sequence(data, false);
+
+        Sequence ret;
+        ret.reserve(spectrum.size());
+        for (size_t k = 0; k < spectrum.size(); k++) {
+            ret.add_element(Number(spectrum[k].real() / data.size(), spectrum[k].imag() / data.size()));
+        }
+        return ret;
+    }, 1, 1)},
+};
+
+#undef APPLY_FLOAT_FUNCTION_TO_NUMBER
+#undef APPLY_FLOAT_FUNCTION_TO_SEQUENCE
+#undef APPLY_FAST_FUNCTION_TO_SEQUENCE
 
-        std::function<void(Number*, size_t)> fft = [&fft] (Number* input_data, size_t N) {
-            if (N < 2) return;
-            // assert((size_t) std::floor(std::log2(N)) == N, "FFT size must be a power of 2");
+void Program::create_user_object(const std::string& name, const uint num_inputs, const uint num_outputs, std::any user_data, const AudioProcessingCallback callback)
+{
+    const Symbol id = intern(name);
+    check_name_is_free(id);
+    object_ids[id] = objects.size();
+    objects.push_back(std::make_unique<UserObject, ArgumentList, const AudioProcessingCallback&, std::any&>({ TypedValue(num_inputs), TypedValue(num_outputs) }, callback, user_data));
+    schedule_is_stale = true;
+}
 
-            size_t M = N / 2;
+void Program::check_name_is_free(const Symbol name) const
+{
+    if (name != unnamed && object_exists(name)) error("Symbol '" + symbol_name(name) + "' is already used");
+}
 
-            auto temp = (Number*) std::malloc(sizeof( Number ) * M);
-            for (size_t n = 0; n < M; n++) temp[n] = input_data[n * 2 + 1];
-            for (size_t n = 0; n < M; n++) input_data[n] = input_data[n * 2];
-            for (size_t n = 0; n < M; n++) input_data[n + M] = temp[n];
-            free(temp);
+ObjectRange Program::create_group(const Symbol name, const size_t first)
+{
+    check_name_is_free(name);
+    if (name != unnamed) group_ids[name] = groups.size();
+    groups.push_back({ name, first, objects.size() - first, true });
+    return groups.back();
+}
 
-            fft(input_data, M);
-            fft(input_data + M, M);
+size_t Program::object_count() const
+{
+    return objects.size();
+}
 
-            for (size_t k = 0; k < M; k++)
-            {
-                Number even = input_data[k];
-                Number odd  = input_data[k + M];
+ObjectRange Program::find_object(const Symbol name) const
+{
+    const auto object = object_ids.find(name);
+    if (object != object_ids.end()) return { name, object->second, 1, false };
 
-                const float theta = -TAU * float(k) / N;
-                Number w   = Number(std::cos(theta), std::sin(theta)).multiply_num(odd);
-                input_data[k]     = even.add_num(w);
-                input_data[k + M] = even.subtract_num(w);
-            }
-        };
+    const auto group = group_ids.find(name);
+    if (group == group_ids.end()) error("Object " + symbol_name(name) + " has not been declared");
+    return groups[group->second];
+}
 
-        fft(data.get_data_pointer(), data.size());
-        for (auto& value: data) value = value.divide_num(data.size());
-        return data;
-    }, 1, 1)},
-};
+void Program::set_origin(const ObjectRange& object, const std::string& type, const size_t line)
+{
+    if (object.name == unnamed) origins[object.first] = type + " on line " + std::to_string(line);
+}
 
-#undef APPLY_FLOAT_FUNCTION_TO_NUMBER
+std::string Program::describe(const ObjectRange& object) const
+{
+    if (object.name != unnamed) return symbol_name(object.name);
+    const auto origin = origins.find(object.first);
+    return origin == origins.end() ? "Unnamed object" : "Unnamed " + origin->second;
+}
 
-void Program::create_user_object(const std::string& name, const uint num_inputs, const uint num_outputs, std::any user_data, const AudioProcessingCallback callback)
+std::string Program::name_of(const AudioObject* const object) const
 {
-    if (table.count(name) != 0) error("Symbol '" + name + "' is already used");
-    table[name] = std::make_unique<UserObject, ArgumentList, const AudioProcessingCallback&, std::any&>({ TypedValue(num_inputs), TypedValue(num_outputs) }, callback, user_data);
+    for (auto const& [name, index] : object_ids)
+        if (objects[index].get() == object) return symbol_name(name);
+
+    for (const ObjectRange& group : groups)
+        for (size_t n = 0; n < group.size; n++)
+            if (objects[group.first + n].get() == object) return describe(group) + "[" + std::to_string(n) + "]";
+
+    for (size_t n = 0; n < objects.size(); n++)
+        if (objects[n].get() == object) return describe({ unnamed, n, 1, false });
+
+    return "Unnamed object";
 }
 
-void Program::check_io_and_connect_objects(const std::string& output_object, const uint output_index,
-                                           const std::string& input_object , const uint input_index)
+void Program::check_io_and_connect_objects(AudioObject* const output_object, const uint output_index,
+                                           AudioObject* const input_object, const uint input_index)
 {
-    if (table[output_object]->outputs.size() <= output_index) {
-        error("Index out of range on output object '" + output_object + "'. Index is: " + std::to_string(output_index));
+    if (output_object->outputs.size() <= output_index) {
+        error("Index out of range on output object '" + name_of(output_object) + "'. Index is: " + std::to_string(output_index));
     }
 
-    if (table[input_object]->inputs.size() <= input_index)
-        error("Index out of range on input object '" + input_object + "'. Index is: " + std::to_string(input_index));
+    if (input_object->inputs.size() <= input_index)
+        error("Index out of range on input object '" + name_of(input_object) + "'. Index is: " + std::to_string(input_index));
 
-    table[output_object]->outputs[output_index].connect(table[input_object]->inputs.at(input_index));
+    output_object->outputs[output_index].connect(input_object->inputs.at(input_index));
+    schedule_is_stale = true;
 }
 
-void Program::expect_to_be_group(const std::string& name) const
+void Program::expect_to_be_group(const ObjectRange& object) const
 {
-    if (table.count(name)) error(name + " is an object, not a group");
-    else if (!group_sizes.count(name)) error("Group " + name + " has not been declared");
+    if (!object.group) error(describe(object) + " is an object, not a group");
 }
 
-void Program::expect_to_be_object(const std::string& name) const
+void Program::expect_to_be_object(const ObjectRange& object) const
 {
-    if (group_sizes.count(name)) error(name + " is a group, not an object");
-    else if (!table.count(name)) error("Object " + name + " has not been declared");
+    if (object.group) error(describe(object) + " is a group, not an object");
 }
 
 void Program::connect_objects(const std::string& output_object, const uint out,
                               const std::string& input_object, const uint in, const ConnectionType type)
 {
+    connect_objects(find_object(intern(output_object)), out, find_object(intern(input_object)), in, type);
+}
+
+void Program::connect_objects(const ObjectRange& output_object, const uint out,
+                              const ObjectRange& input_object, const uint in, const ConnectionType type)
+{
+    const auto object = [this] (const ObjectRange& range, const size_t n) { return objects[range.first + n].get(); };
+
     if (type == ConnectionType::one_to_one) {
         expect_to_be_object(output_object);
         expect_to_be_object(input_object);
-        check_io_and_connect_objects(output_object, out, input_object, in);
+        check_io_and_connect_objects(object(output_object, 0), out, object(input_object, 0), in);
     }
 
     else if (type == ConnectionType::many_to_one) {
         expect_to_be_group(output_object);
         expect_to_be_object(input_object);
-        for (size_t n = 0; n < group_sizes[output_object]; n++)
-            check_io_and_connect_objects("__grp_" + output_object + std::to_string(n), out, input_object, in);
+        for (size_t n = 0; n < output_object.size; n++)
+            check_io_and_connect_objects(object(output_object, n), out, object(input_object, 0), in);
     }
 
     else if (type == ConnectionType::one_to_many) {
         expect_to_be_object(output_object);
         expect_to_be_group(input_object);
-        for (size_t n = 0; n < group_sizes[input_object]; n++)
-            check_io_and_connect_objects(output_object, out, "__grp_" + input_object + std::to_string(n), in);
+        for (size_t n = 0; n < input_object.size; n++)
+            check_io_and_connect_objects(object(output_object, 0), out, object(input_object, n), in);
     }
 
     else if (type == ConnectionType::series) {
         expect_to_be_group(input_object);
-        for (size_t n = 0; n < group_sizes[input_object] - 1; n++)
-            check_io_and_connect_objects("__grp_" + input_object + std::to_string(n), 0, "__grp_" + input_object + std::to_string(n + 1), in);
+        for (size_t n = 0; n + 1 < input_object.size; n++)
+            check_io_and_connect_objects(object(input_object, n), 0, object(input_object, n + 1), in);
     }
 
     else if (type == ConnectionType::biclique) {
         expect_to_be_group(output_object);
         expect_to_be_group(input_object);
-        for (size_t na = 0; na < group_sizes[output_object]; na++) {
-            for (size_t nb = 0; nb < group_sizes[input_object]; nb++) {
-                check_io_and_connect_objects("__grp_" + output_object + std::to_string(na), out,
-                                "__grp_" + input_object + std::to_string(nb), in);
+        for (size_t na = 0; na < output_object.size; na++) {
+            for (size_t nb = 0; nb < input_object.size; nb++) {
+                check_io_and_connect_objects(object(output_object, na), out, object(input_object, nb), in);
             }
         }
     }
@@ -761,24 +930,736 @@ void Program::connect_objects(const std::string& output_object, const uint out,
     else if (type == ConnectionType::many_to_many) {
         expect_to_be_group(output_object);
         expect_to_be_group(input_object);
-        if (group_sizes[output_object] != group_sizes[input_object]) error("Group sizes to be connected in parallel are not identical");
-        for (size_t n = 0; n < group_sizes[output_object]; n++)
-            check_io_and_connect_objects("__grp_" + output_object + std::to_string(n), out,
-                            "__grp_" + input_object + std::to_string(n), in);
+        if (output_object.size != input_object.size) error("Group sizes to be connected in parallel are not identical");
+        for (size_t n = 0; n < output_object.size; n++)
+            check_io_and_connect_objects(object(output_object, n), out, object(input_object, n), in);
     }
 }
 
+bool Program::object_exists(const Symbol name) const
+{
+    return object_ids.count(name) || group_ids.count(name);
+}
+
 bool Program::object_exists(const std::string& name) const
 {
-    if (table.count(name) || group_sizes.count(name)) return true;
+    return object_exists(intern(name));
+}
+
+void Program::set_fast_math(const bool enabled)
+{
+    fast_math = enabled;
+    schedule_is_stale = true;
+}
+
+bool Program::uses_fast_math() const
+{
+    if (symbol_exists("fast_math") && symbol_is_type<Number>("fast_math"))
+        return (float) get_symbol_value<Number>("fast_math") != 0.f;
+    return fast_math || (parent && parent->uses_fast_math());
+}
+
+void Program::set_thread_count(const size_t count)
+{
+    threads = std::max<size_t>(count, 1);
+    schedule_is_stale = true;
+}
+
+size_t Program::thread_count() const
+{
+    if (symbol_exists("threads") && symbol_is_type<Number>("threads"))
+        return (size_t) std::max((float) get_symbol_value<Number>("threads"), 1.f);
+    if (threads > 1 || !parent) return threads;
+    return parent->thread_count();
+}
+
+// Orders the members of a feedback loop so that, where it can, only connections into its delays go
+// backwards, given how many connections there are into the delay of each. Where a cycle is left
+// without a delay, the next member in order is run first, and the connections into it from the
+// rest of the cycle go backwards. Returns whether that was needed.
+using Edges = std::map<std::pair<AudioObject*, AudioObject*>, size_t>;
+static bool order_through_delays(std::vector<AudioObject*>& component, std::map<AudioObject*, std::vector<AudioObject*>>& successors,
+                                 const Edges& into_delays)
+{
+    const std::set<AudioObject*> members(component.begin(), component.end());
+    std::map<AudioObject*, size_t> incoming;
+    Edges cut;
+    for (AudioObject* const object : component) {
+        for (AudioObject* const target : successors[object]) {
+            if (!members.count(target)) continue;
+            const auto delay = into_delays.find({ object, target });
+            if (delay != into_delays.end() && cut[delay->first] < delay->second) cut[delay->first]++;
+            else incoming[target]++;
+        }
+    }
+
+    std::vector<AudioObject*> order;
+    std::set<AudioObject*> placed;
+    bool broken = false;
+    while (order.size() < component.size()) {
+        auto next = std::find_if(component.begin(), component.end(), [&] (AudioObject* const object) {
+            return !placed.count(object) && !incoming[object];
+        });
+        if (next == component.end()) {
+            next = std::find_if(component.begin(), component.end(), [&placed] (AudioObject* const object) {
+                return !placed.count(object);
+            });
+            broken = true;
+        }
+
+        AudioObject* const object = *next;
+        order.push_back(object);
+        placed.insert(object);
+
+        Edges skipped;
+        for (AudioObject* const target : successors[object]) {
+            if (!members.count(target)) continue;
+            const auto delay = cut.find({ object, target });
+            if (delay != cut.end() && skipped[delay->first] < delay->second) skipped[delay->first]++;
+            else if (incoming[target]) incoming[target]--;
+        }
+    }
+
+    component.swap(order);
+    return broken;
+}
+
+template <typename Callback>
+static void depth_first_search(AudioObject* const root, std::map<AudioObject*, std::vector<AudioObject*>>& edges,
+                               std::set<AudioObject*>& visited, const Callback finish)
+{
+    std::vector<std::pair<AudioObject*, size_t>> stack = { { root, 0 } };
+    visited.insert(root);
+
+    while (!stack.empty()) {
+        auto& [object, next_edge] = stack.back();
+        const std::vector<AudioObject*>& targets = edges[object];
+
+        if (next_edge == targets.size()) {
+            finish(object);
+            stack.pop_back();
+            continue;
+        }
+
+        AudioObject* const target = targets[next_edge++];
+        if (visited.insert(target).second) stack.push_back({ target, 0 });
+    }
+}
+
+void Program::form_object_groups(std::map<AudioObject*, std::vector<AudioObject*>>& successors,
+                                 const std::set<AudioObject*>& scheduled)
+{
+    // Groups are made afresh, and hand the state they took over back to their members first
+    object_groups.clear();
+
+    // Whether the objects, taken as a single step along with each group formed so far, would
+    // feed themselves, through what the sources among them feed. Members of groups aren't in
+    // feedback loops, so any such cycle is one the groups would make up, or a member feeding
+    // another or itself.
+    std::map<AudioObject*, const ObjectGroup*> formed;
+    const auto closes_cycle = [&] (const std::set<AudioObject*>& candidate, const std::set<AudioObject*>& sources) {
+        std::set<AudioObject*> visited;
+        std::vector<AudioObject*> stack;
+        const auto visit = [&] (AudioObject* const object) {
+            const auto group = formed.find(object);
+            if (group == formed.end()) {
+                if (visited.insert(object).second) stack.push_back(object);
+                return;
+            }
+            for (AudioObject* const member : group->second->get_members())
+                if (visited.insert(member).second) stack.push_back(member);
+        };
+
+        for (AudioObject* const source : sources)
+            for (AudioObject* const successor : successors[source]) visit(successor);
+
+        while (!stack.empty()) {
+            AudioObject* const object = stack.back();
+            stack.pop_back();
+            if (candidate.count(object)) return true;
+            for (AudioObject* const successor : successors[object]) visit(successor);
+        }
+        return false;
+    };
+
+    for (const ObjectRange& range : groups) {
+        std::vector<AudioObject*> members;
+        for (size_t n = range.first; n < range.first + range.size; n++)
+            if (scheduled.count(objects[n].get())) members.push_back(objects[n].get());
+        if (members.size() < 2) continue;
+
+        std::unique_ptr<ObjectGroup> group = members[0]->make_group();
+        if (!group) continue;
+
+        // Members feeding each other, in a feedback loop, or closing a cycle through other
+        // groups, have to be run on their own
+        std::set<AudioObject*> accepted;
+        for (AudioObject* const member : members) {
+            if (!group->accepts(member)) continue;
+
+            accepted.insert(member);
+            if (closes_cycle(accepted, accepted)) accepted.erase(member);
+        }
+        if (accepted.size() < 2) continue;
+
+        for (AudioObject* const member : members)
+            if (accepted.count(member)) group->add_member(member);
+        for (AudioObject* const member : accepted) formed[member] = group.get();
+        object_groups.push_back(std::move(group));
+    }
+
+    // Element-wise objects whose only connection is to the first input of another, which has
+    // no other connection there, are fused with it. Following those links from an object that
+    // isn't linked to gives a chain, which is run as one kernel. The links inside a chain are
+    // left out of the graph, so a chain stops before an object feeding back into it, which
+    // starts a chain of its own.
+    std::set<AudioObject*> grouped;
+    for (auto const& group : object_groups)
+        grouped.insert(group->get_members().begin(), group->get_members().end());
+
+    const ElementwiseChain chain;
+    const auto next_in_chain = [&] (AudioObject* const object) -> AudioObject* {
+        if (!chain.accepts(object) || grouped.count(object) || successors[object].size() != 1) return nullptr;
+
+        AudioObject* const consumer = successors[object][0];
+        const auto& connections = consumer->inputs[0].connections;
+        const bool linked = consumer != object && scheduled.count(consumer) && !grouped.count(consumer)
+                         && chain.accepts(consumer) && connections.size() == 1
+                         && connections[0] == object->outputs[0].connections[0];
+        return linked ? consumer : nullptr;
+    };
+
+    std::set<AudioObject*> linked_to;
+    for (auto const& object : objects)
+        if (scheduled.count(object.get()))
+            if (AudioObject* const next = next_in_chain(object.get())) linked_to.insert(next);
+
+    std::vector<AudioObject*> heads;
+    for (auto const& object : objects)
+        if (scheduled.count(object.get()) && !linked_to.count(object.get())) heads.push_back(object.get());
+
+    for (size_t n = 0; n < heads.size(); n++) {
+        std::vector<AudioObject*> members = { heads[n] };
+        std::set<AudioObject*> chained = { heads[n] };
+        while (AudioObject* const next = next_in_chain(members.back())) {
+            chained.insert(next);
+            if (closes_cycle(chained, { next })) {
+                heads.push_back(next);
+                break;
+            }
+            members.push_back(next);
+        }
+        if (members.size() < 2) continue;
+
+        auto group = std::make_unique<ElementwiseChain>();
+        for (AudioObject* const member : members) group->add_member(member);
+        object_groups.push_back(std::move(group));
+    }
+}
+
+std::set<AudioObject*> Program::evaluate_constant_objects(const std::unordered_map<AudioConnector*, AudioObject*>& consumers)
+{
+    // Pure objects are constant once everything feeding them is. Multiplying by zero doesn't
+    // make an object constant on its own, as infinities and NaNs fed to it still come out.
+    // Each is run as soon as it is found to be constant, on buffers of its own, which it keeps.
+    std::map<AudioObject*, size_t> unresolved_connections;
+    std::vector<AudioObject*> ready;
+    for (auto const& object : objects) {
+        size_t connections = 0;
+        for (auto const& input : object->inputs) connections += input.connections.size();
+
+        unresolved_connections[object.get()] = connections;
+        if (object->is_pure() && !connections) ready.push_back(object.get());
+    }
+
+    std::set<AudioObject*> constants;
+    while (!ready.empty()) {
+        AudioObject* const object = ready.back();
+        ready.pop_back();
+        if (!constants.insert(object).second) continue;
+
+        object->pass_through(false);
+        for (size_t n = 0; n < object->outputs.size(); n++) object->bind_output(n, AudioBuffer(blocksize));
+
+        for (auto& input : object->inputs)
+            if (input.is_mixed()) input.mix = AudioBuffer(blocksize);
+        object->implement(0, blocksize);
+
+        for (auto const& output : object->outputs) {
+            for (auto const& connector : output.connections) {
+                AudioObject* const consumer = consumers.at(connector.get());
+                if (!--unresolved_connections.at(consumer) && consumer->is_pure()) ready.push_back(consumer);
+            }
+        }
+    }
+    return constants;
+}
+
+bool Program::has_side_effects() const
+{
+    for (auto const& object : objects)
+        if (object->has_side_effects()) return true;
     return false;
 }
 
-void Program::simulate()
+std::vector<AudioObject*> Program::objects_at(const size_t position) const
+{
+    if (auto const* group = dynamic_cast<const ObjectGroup*>(schedule[position])) return group->get_members();
+    return { schedule[position] };
+}
+
+void Program::compile()
+{
+    // Orders the objects so that every object runs after the objects feeding it.
+    // Objects that feed back into each other (strongly connected components) are kept
+    // together in the schedule, and are run alternately in sub-blocks. Connections closing
+    // such a loop are read one sub-block late.
+
+    std::unordered_map<AudioConnector*, AudioObject*> consumers;
+    for (auto const& object : objects)
+        for (auto const& input : object->inputs)
+            for (auto const& connector : input.connections)
+                consumers[connector.get()] = object.get();
+
+    const bool fast = uses_fast_math();
+    std::map<AudioObject*, std::vector<AudioObject*>> successors, predecessors;
+    std::unordered_map<AudioConnector*, AudioObject*> producers;
+    for (auto const& object : objects) {
+        for (auto const& output : object->outputs) {
+            for (auto const& connector : output.connections) {
+                AudioObject* const consumer = consumers.at(connector.get());
+                successors[object.get()].push_back(consumer);
+                predecessors[consumer].push_back(object.get());
+                producers[connector.get()] = object.get();
+                connector->delay = 0;
+                connector->history.clear();
+                connector->gain = 1.f;
+            }
+        }
+        object->compensate_feedback_latency(0);
+        object->use_fast_math(fast);
+    }
+
+    // Objects with a constant output are run once, here. Of the rest, only those feeding the
+    // output or an object with side effects are scheduled.
+    const std::set<AudioObject*> constants = evaluate_constant_objects(consumers);
+
+    std::set<AudioObject*> live;
+    std::vector<AudioObject*> unvisited;
+    const auto output = object_ids.find(output_symbol);
+    for (auto const& object : objects) {
+        const bool is_output = output != object_ids.end() && objects[output->second] == object;
+        if ((is_output || object->has_side_effects()) && !constants.count(object.get())) {
+            live.insert(object.get());
+            unvisited.push_back(object.get());
+        }
+    }
+    while (!unvisited.empty()) {
+        AudioObject* const object = unvisited.back();
+        unvisited.pop_back();
+        for (AudioObject* const predecessor : predecessors[object])
+            if (!constants.count(predecessor) && live.insert(predecessor).second) unvisited.push_back(predecessor);
+    }
+
+    // Grouped objects are scheduled as their group, which stands in for them in the graph
+    form_object_groups(successors, live);
+    std::map<AudioObject*, AudioObject*> group_of;
+    for (auto const& group : object_groups)
+        for (AudioObject* const member : group->get_members())
+            group_of[member] = group.get();
+
+    std::vector<AudioObject*> nodes;
+    for (auto const& object : objects)
+        if (live.count(object.get()) && !group_of.count(object.get())) nodes.push_back(object.get());
+    for (auto const& group : object_groups) nodes.push_back(group.get());
+
+    const auto node = [&group_of] (AudioObject* const object) {
+        return group_of.count(object) ? group_of.at(object) : object;
+    };
+
+    std::map<AudioObject*, std::vector<AudioObject*>> node_successors, node_predecessors;
+    for (auto const& [object, targets] : successors) {
+        if (!live.count(object)) continue;
+        for (AudioObject* const target : targets) {
+            if (!live.count(target) || (target != object && node(target) == node(object))) continue;
+            node_successors[node(object)].push_back(node(target));
+            node_predecessors[node(target)].push_back(node(object));
+        }
+    }
+    successors.swap(node_successors);
+    predecessors.swap(node_predecessors);
+
+    Edges into_delays;
+    for (AudioObject* const object : nodes) {
+        if (!object->feedback_delay()) continue;
+        for (auto const& connector : object->inputs[0].connections) {
+            AudioObject* const producer = producers.at(connector.get());
+            if (live.count(producer)) into_delays[{ node(producer), object }]++;
+        }
+    }
+
+    // Reverse postorder of a depth-first search, started from objects with no connected inputs first
+    std::vector<AudioObject*> roots;
+    for (AudioObject* const object : nodes)
+        if (!predecessors.count(object)) roots.push_back(object);
+    for (AudioObject* const object : nodes)
+        if (predecessors.count(object)) roots.push_back(object);
+
+    std::set<AudioObject*> visited;
+    std::vector<AudioObject*> order;
+    for (AudioObject* const root : roots)
+        if (!visited.count(root))
+            depth_first_search(root, successors, visited, [&order] (AudioObject* object) { order.push_back(object); });
+    std::reverse(order.begin(), order.end());
+
+    std::map<AudioObject*, size_t> position_in_order;
+    for (size_t n = 0; n < order.size(); n++) position_in_order[order[n]] = n;
+
+    // Searching backwards along the connections, in that order, visits one strongly
+    // connected component at a time, in dataflow order (Kosaraju's algorithm)
+    schedule.clear();
+    feedback_loops.clear();
+    visited.clear();
+
+    for (AudioObject* const root : order) {
+        if (visited.count(root)) continue;
+
+        std::vector<AudioObject*> component;
+        depth_first_search(root, predecessors, visited, [&component] (AudioObject* object) { component.push_back(object); });
+        std::sort(component.begin(), component.end(), [&position_in_order] (AudioObject* a, AudioObject* b) {
+            return position_in_order.at(a) < position_in_order.at(b);
+        });
+
+        const auto& root_successors = successors[root];
+        const bool is_loop = component.size() > 1
+            || std::find(root_successors.begin(), root_successors.end(), root) != root_successors.end();
+
+        if (!is_loop) {
+            schedule.push_back(root);
+            continue;
+        }
+
+        // Loops run in sub-blocks no longer than their shortest delay. Every connection into a
+        // delay is read a sub-block late, and the delay takes the sub-block off its own. Loops
+        // with a cycle that has no delay are run one sample at a time.
+        Segment loop { schedule.size(), schedule.size() + component.size(), 1, { } };
+        for (AudioObject* const object : component)
+            if (object->feedback_delay()) loop.delays.push_back(object);
+
+        const bool broken = order_through_delays(component, successors, into_delays);
+        if (!broken && !loop.delays.empty()) {
+            size_t limit = blocksize;
+            for (AudioObject* const delay : loop.delays) limit = std::min(limit, delay->feedback_delay());
+            for (size_t length = limit; length >= 1; length--) {
+                if (blocksize % length == 0) {
+                    loop.subblock_length = length;
+                    break;
+                }
+            }
+        }
+        for (AudioObject* const delay : loop.delays) delay->compensate_feedback_latency(loop.subblock_length);
+
+        schedule.insert(schedule.end(), component.begin(), component.end());
+        feedback_loops.push_back(loop);
+    }
+
+    std::map<AudioObject*, size_t> position_in_schedule;
+    for (size_t n = 0; n < schedule.size(); n++)
+        for (AudioObject* const object : objects_at(n))
+            position_in_schedule[object] = n;
+
+    for (Segment& loop : feedback_loops) {
+        // Connections into the delays, and those going backwards, are read a sub-block late.
+        // Those from earlier in the schedule keep the end of the block before, as their producer
+        // may have written over it by then, when the sub-block is the whole block. Connections
+        // between the members of a group are run in order by the group itself.
+        for (size_t n = loop.first; n < loop.last; n++) {
+            for (AudioObject* const object : objects_at(n)) {
+                for (auto const& input : object->inputs) {
+                    for (auto const& connector : input.connections) {
+                        AudioObject* const producer = producers.at(connector.get());
+                        const auto position = position_in_schedule.find(producer);
+                        if (position == position_in_schedule.end()) continue;
+
+                        const size_t source = position->second;
+                        const bool into_delay = &input == &object->inputs[0]
+                            && std::count(loop.delays.begin(), loop.delays.end(), object);
+                        if (!into_delay && (source < loop.first || source < n || (source == n && producer != object))) continue;
+                        connector->delay = loop.subblock_length;
+                        connector->period = blocksize;
+                        if (source < n) connector->history.assign(2 * loop.subblock_length, 0.f);
+                    }
+                }
+            }
+        }
+    }
+
+    // A constant multiplication after a sum of several connections is folded into the sum. The
+    // multiplication then processes in place over it, so there is nothing left for it to do.
+    // Objects that leave their input unchanged pass it through the same way.
+    std::set<AudioObject*> looped;
+    for (const Segment& loop : feedback_loops)
+        looped.insert(schedule.begin() + loop.first, schedule.begin() + loop.last);
+
+    for (AudioObject* const object : schedule) {
+        const std::optional<float> gain = object->constant_gain();
+        const bool folded = gain && !looped.count(object) && object->inputs[0].connections.size() > 1;
+        const bool identity = !looped.count(object) && object->is_identity() && object->is_connected(0);
+
+        object->pass_through(folded || identity);
+        if (folded)
+            for (auto const& connector : object->inputs[0].connections)
+                connector->gain = *gain;
+    }
+
+    plan_tasks(consumers, position_in_schedule);
+    allocate_buffers(consumers, position_in_schedule, tasks != nullptr);
+    lower_steps();
+    schedule_is_stale = false;
+}
+
+void Program::lower_steps()
+{
+    instructions.clear();
+
+    // Loops through delays read their connections through AudioConnector::read(), which keeps
+    // the history of those from outside them, so they aren't lowered
+    for (Segment& step : steps) {
+        step.lowered = step.subblock_length == blocksize && step.last == step.first + 1 && step.delays.empty();
+        if (!step.lowered) continue;
+
+        // Groups are bound after their members, and run them all on the buffers they were bound to
+        AudioObject* const object = schedule[step.first];
+        step.first_instruction = instructions.size();
+
+        for (AudioObject* const member : objects_at(step.first)) {
+            for (auto& input : member->inputs) {
+                if (!input.is_mixed()) continue;
+
+                Instruction mix { nullptr, input.mix.data_pointer(), { } };
+                for (auto const& connector : input.connections)
+                    mix.sources.push_back({ connector->stored_buffer.data_pointer(), connector->gain });
+                instructions.push_back(std::move(mix));
+            }
+            if (member != object) member->bind_block(blocksize);
+        }
+
+        if (!object->is_passing_through()) {
+            object->bind_block(blocksize);
+            instructions.push_back({ object, nullptr, { } });
+        }
+        step.last_instruction = instructions.size();
+    }
+}
+
+void Program::plan_tasks(const std::unordered_map<AudioConnector*, AudioObject*>& consumers,
+                         const std::map<AudioObject*, size_t>& position_in_schedule)
+{
+    steps.clear();
+    tasks.reset();
+
+    std::vector<size_t> step_of_position(schedule.size());
+    for (size_t position = 0, loop = 0; position < schedule.size();) {
+        if (loop < feedback_loops.size() && feedback_loops[loop].first == position) {
+            steps.push_back(feedback_loops[loop++]);
+        }
+        else steps.push_back({ position, position + 1, blocksize, { } });
+
+        for (; position < steps.back().last; position++) step_of_position[position] = steps.size() - 1;
+    }
+
+    task_threads = thread_count();
+    if (task_threads <= 1 || steps.size() < min_parallel_steps) return;
+
+    std::vector<std::vector<size_t>> successors(steps.size());
+    for (size_t step = 0; step < steps.size(); step++) {
+        for (size_t position = steps[step].first; position < steps[step].last; position++) {
+            for (AudioObject* const object : objects_at(position)) {
+                for (auto const& output : object->outputs) {
+                    for (auto const& connector : output.connections) {
+                        const auto consumer = position_in_schedule.find(consumers.at(connector.get()));
+                        if (consumer == position_in_schedule.end()) continue;
+
+                        const size_t target = step_of_position[consumer->second];
+                        auto& targets = successors[step];
+                        if (target != step && std::find(targets.begin(), targets.end(), target) == targets.end())
+                            targets.push_back(target);
+                    }
+                }
+            }
+        }
+    }
+
+    // Threads only help if there are enough steps that can run side by side, which is at best
+    // the number of steps over the length of the longest chain of steps depending on each other
+    std::vector<size_t> chain_length(steps.size(), 1);
+    size_t longest_chain = 1;
+    for (size_t step = 0; step < steps.size(); step++) {
+        longest_chain = std::max(longest_chain, chain_length[step]);
+        for (const size_t target : successors[step])
+            chain_length[target] = std::max(chain_length[target], chain_length[step] + 1);
+    }
+    if (steps.size() < 2 * longest_chain) return;
+
+    tasks = std::make_unique<TaskGraph>(successors, [this] (const size_t step) { run_step(steps[step]); });
+}
+
+void Program::allocate_buffers(const std::unordered_map<AudioConnector*, AudioObject*>& consumers,
+                               const std::map<AudioObject*, size_t>& position_in_schedule,
+                               const bool multithreaded)
 {
-    for (const auto& entry : table) {
-        entry.second->implement();
+    // Every output, and every input summing several connections, gets a slot in the arena.
+    // Buffers whose lifetimes don't overlap share a slot. Lifetimes are measured in steps of
+    // the schedule, a whole feedback loop being a single step, and the outputs of objects in
+    // a loop are read again in the next block, so they keep their slot for good. Objects that
+    // can process in place take over the slot of their first input when it is last read by them.
+    // Objects passing their input through share its slot for as long as either is read. Steps run
+    // on several threads at once don't follow the order of the schedule, so then buffers are
+    // only shared by objects and their inputs. Constant objects have buffers of their own.
+
+    constexpr size_t forever = std::numeric_limits<size_t>::max();
+
+    std::vector<size_t> step(schedule.size());
+    std::vector<bool> in_loop(schedule.size(), false);
+    size_t current_step = 0;
+    for (size_t position = 0, loop = 0; position < schedule.size(); current_step++) {
+        if (loop < feedback_loops.size() && feedback_loops[loop].first == position) {
+            for (; position < feedback_loops[loop].last; position++) {
+                step[position] = current_step;
+                in_loop[position] = true;
+            }
+            loop++;
+        }
+        else step[position++] = current_step;
     }
+
+    constexpr size_t unshared = std::numeric_limits<size_t>::max();
+
+    struct Lifetime
+    {
+        size_t first_step;
+        size_t last_step;
+        AudioObject* object;
+        bool is_output;
+        size_t index;
+        size_t shares_with;
+        size_t slot;
+    };
+
+    std::vector<Lifetime> lifetimes;
+    std::map<AudioConnector*, size_t> source_lifetimes;
+    for (size_t position = 0; position < schedule.size(); position++) {
+        for (AudioObject* const object : objects_at(position)) {
+            size_t first_input = unshared;
+
+            for (size_t n = 0; n < object->inputs.size(); n++) {
+                auto const& connections = object->inputs[n].connections;
+                if (object->inputs[n].is_mixed()) {
+                    if (n == 0) first_input = lifetimes.size();
+                    lifetimes.push_back({ step[position], step[position], object, false, n, unshared, 0 });
+                }
+                else if (n == 0 && connections.size() == 1 && !connections[0]->delay) {
+                    const auto source = source_lifetimes.find(connections[0].get());
+                    if (source != source_lifetimes.end()) first_input = source->second;
+                }
+            }
+
+            // Writing over the first input is only safe once every other reader of it has run. With
+            // several threads, that is only certain for an input mixed by the object itself.
+            const bool in_place = object->can_process_in_place() && !in_loop[position] && first_input != unshared
+                               && lifetimes[first_input].last_step == step[position]
+                               && (!multithreaded || object->inputs[0].is_mixed());
+            const bool passes_through = object->is_passing_through() && first_input != unshared;
+
+            for (size_t n = 0; n < object->outputs.size(); n++) {
+                size_t last_step = step[position];
+                for (auto const& connector : object->outputs[n].connections) {
+                    const auto consumer = position_in_schedule.find(consumers.at(connector.get()));
+                    if (consumer != position_in_schedule.end()) last_step = std::max(last_step, step[consumer->second]);
+                    source_lifetimes[connector.get()] = lifetimes.size();
+                }
+
+                if (in_loop[position]) last_step = forever;
+                size_t shares_with = unshared;
+                if (n == 0 && (in_place || passes_through)) {
+                    shares_with = first_input;
+                    for (size_t shared = first_input; shared != unshared; shared = lifetimes[shared].shares_with)
+                        last_step = std::max(last_step, lifetimes[shared].last_step);
+                    for (size_t shared = first_input; shared != unshared; shared = lifetimes[shared].shares_with)
+                        lifetimes[shared].last_step = last_step;
+                }
+                lifetimes.push_back({ step[position], last_step, object, true, n, shares_with, 0 });
+            }
+        }
+    }
+
+    using Occupant = std::pair<size_t, size_t>;
+    std::priority_queue<Occupant, std::vector<Occupant>, std::greater<Occupant>> occupied;
+    std::vector<size_t> free_slots;
+    std::vector<size_t> release_steps;
+    size_t slot_count = 0;
+
+    for (Lifetime& lifetime : lifetimes) {
+        while (!occupied.empty() && occupied.top().first < lifetime.first_step) {
+            const auto [release_step, slot] = occupied.top();
+            occupied.pop();
+            if (release_step == release_steps[slot]) free_slots.push_back(slot);
+        }
+
+        if (lifetime.shares_with != unshared) {
+            lifetime.slot = lifetimes[lifetime.shares_with].slot;
+            if (lifetime.last_step <= release_steps[lifetime.slot]) continue;
+        }
+        else if (free_slots.empty() || multithreaded) {
+            lifetime.slot = slot_count++;
+            release_steps.push_back(0);
+        }
+        else {
+            lifetime.slot = free_slots.back();
+            free_slots.pop_back();
+        }
+
+        release_steps[lifetime.slot] = lifetime.last_step;
+        occupied.push({ lifetime.last_step, lifetime.slot });
+    }
+
+    arena.allocate(slot_count, blocksize);
+    for (const Lifetime& lifetime : lifetimes) {
+        const AudioBuffer buffer = arena.slot(lifetime.slot, blocksize);
+        if (lifetime.is_output) lifetime.object->bind_output(lifetime.index, buffer);
+        else lifetime.object->inputs[lifetime.index].mix = buffer;
+    }
+}
+
+void Program::run_step(const Segment& step)
+{
+    if (step.lowered) {
+        for (size_t n = step.first_instruction; n < step.last_instruction; n++) {
+            const Instruction& instruction = instructions[n];
+            if (instruction.object) {
+                instruction.object->run_block();
+                continue;
+            }
+
+            const auto& sources = instruction.sources;
+            copy_scaled(instruction.mix, sources[0].first, blocksize, sources[0].second);
+            for (size_t source = 1; source < sources.size(); source++)
+                accumulate(instruction.mix, sources[source].first, blocksize, sources[source].second);
+        }
+        return;
+    }
+
+    for (size_t offset = 0; offset < blocksize; offset += step.subblock_length)
+        for (size_t n = step.first; n < step.last; n++)
+            schedule[n]->implement(offset, step.subblock_length);
+}
+
+void Program::simulate()
+{
+    if (schedule_is_stale) compile();
+
+    if (tasks) tasks->run(task_threads);
+    else for (const Segment& step : steps) run_step(step);
 }
 
 MultichannelBuffer Program::run()
@@ -786,40 +1667,49 @@ MultichannelBuffer Program::run()
     return run( { AudioBuffer::zero } );
 }
 
-MultichannelBuffer Program::run(const MultichannelBuffer input_buffer)
+MultichannelBuffer Program::run(const MultichannelBuffer& input_buffer)
 {
+    return run(input_buffer, blocksize);
+}
+
+MultichannelBuffer Program::run(const MultichannelBuffer& input_buffer, const size_t length)
+{
+    set_blocksize(length);
+
     if (inputs) {
-        AudioInputObject* object = get_audio_object_raw_pointer<AudioInputObject>("input");
+        AudioInputObject* object = get_audio_object_raw_pointer<AudioInputObject>(find_object(input_symbol));
         object->data = input_buffer;
     }
 
     simulate();
-    MultichannelBuffer output_buffer(outputs);
+    if (!outputs) return { };
 
-    if (outputs) {
-        AudioOutputObject* object = get_audio_object_raw_pointer<AudioOutputObject>("output");
-        output_buffer = object->data;
-        object->data.clear();
-    }
-
-    return output_buffer;
+    return get_audio_object_raw_pointer<AudioOutputObject>(find_object(output_symbol))->data;
 }
 
 void Program::finish()
 {
-    for (auto const& entry : table)
-        entry.second->finish();
+    for (auto const& object : objects)
+        object->finish();
 }
 
 void Program::reset()
 {
-    table.clear();
+    object_groups.clear();
+    objects.clear();
+    object_ids.clear();
+    schedule.clear();
+    steps.clear();
+    tasks.reset();
+    schedule_is_stale = true;
     symbol_table.clear();
-    group_sizes.clear();
+    groups.clear();
+    group_ids.clear();
+    origins.clear();
     subgraphs.clear();
 
-    if (inputs) create_object<AudioInputObject>("input", { inputs });
-    if (outputs) create_object<AudioOutputObject>("output", { outputs });
+    if (inputs) create_object<AudioInputObject>(input_symbol, { inputs });
+    if (outputs) create_object<AudioOutputObject>(output_symbol, { outputs });
 }
 
 void Program::add_directive(const std::string& name, const DirectiveFunctor function)
@@ -835,6 +1725,21 @@ void Program::invoke_directive(const std::string& name, const ArgumentList& argu
     custom_directives.at(name)(arguments, this);
 }
 
+void Program::set_blocksize(const size_t length)
+{
+    Volsung::assert(length >= 1 && length <= AudioBuffer::max_blocksize,
+                    "Block size must be between 1 and " + std::to_string(AudioBuffer::max_blocksize));
+    if (length == blocksize) return;
+
+    blocksize = length;
+    schedule_is_stale = true;
+}
+
+size_t Program::get_blocksize() const
+{
+    return blocksize;
+}
+
 void Program::configure_io(const uint i, const uint o)
 {
     inputs = i;
@@ -842,32 +1747,51 @@ void Program::configure_io(const uint i, const uint o)
     out.resize(outputs);
 }
 
+void Program::add_symbol(const Symbol identifier, const TypedValue& value)
+{
+    if (!symbol_table.emplace(identifier, value).second) error("Identifier '" + symbol_name(identifier) + "' is already in use");
+}
+
+void Program::remove_symbol(const Symbol identifier)
+{
+    symbol_table.erase(identifier);
+}
+
+bool Program::symbol_exists(const Symbol identifier) const
+{
+    return symbol_table.count(identifier) == 1;
+}
+
+TypedValue Program::get_symbol_value(const Symbol identifier) const
+{
+    return symbol_table.at(identifier);
+}
+
 void Program::add_symbol(const std::string& identifier, const TypedValue& value)
 {
-    if (symbol_exists(identifier)) error("Identifier '" + identifier + "' is already in use");
-    symbol_table[identifier] = value;
+    add_symbol(intern(identifier), value);
 }
 
 void Program::remove_symbol(const std::string& identifier)
 {
-    if (symbol_exists(identifier)) symbol_table.erase(identifier);
+    remove_symbol(intern(identifier));
 }
 
 bool Program::symbol_exists(const std::string& identifier) const
 {
-    return symbol_table.count(identifier) == 1;
+    return symbol_exists(intern(identifier));
 }
 
 TypedValue Program::get_symbol_value(const std::string& identifier) const
 {
-
-    return symbol_table.at(identifier);
+    return get_symbol_value(intern(identifier));
 }
 
-const SubgraphRepresentation Program::find_subgraph_recursively(std::string name)
+const SubgraphRepresentation& Program::find_subgraph_recursively(const Symbol name) const
 {
-    if (subgraphs.count(name)) return subgraphs[name];
-    if (!parent) error("Object type does not exist " + name);
+    const auto subgraph = subgraphs.find(name);
+    if (subgraph != subgraphs.end()) return subgraph->second;
+    if (!parent) error("Object type does not exist " + symbol_name(name));
     return parent->find_subgraph_recursively(name);
 }
 
@@ -0,0 +1,534 @@
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "Kernels.hh"
+
+namespace Volsung {
+
+namespace {
+
+// Generic vectors are lowered to whatever the target supports: AVX registers when built
+// with VOLSUNG_AVX2, SSE registers on plain x86-64, or scalar code elsewhere
+#ifdef __AVX__
+constexpr size_t lanes = 8;
+#else
+constexpr size_t lanes = 4;
+#endif
+using Vector = float __attribute__((vector_size(lanes * sizeof(float))));
+using Mask = std::int32_t __attribute__((vector_size(lanes * sizeof(std::int32_t))));
+
+constexpr float half_pi = 1.57079632679f;
+constexpr float quarter_pi = 0.78539816339f;
+
+// π and ln(2) split into parts that can be multiplied by small integers exactly
+constexpr float pi_a = 3.140625f;
+constexpr float pi_b = 9.67502593994140625e-4f;
+constexpr float pi_c = 1.509957990978376432e-7f;
+constexpr float ln2_a = 0.693359375f;
+constexpr float ln2_b = -2.12194440e-4f;
+
+// Past this, reducing the argument of sin and cos loses too much accuracy
+constexpr float trigonometric_limit = 65536.f;
+
+__attribute__((always_inline))
+inline Vector broadcast(const float value)
+{
+    return Vector { } + value;
+}
+
+__attribute__((always_inline))
+inline Vector load(const float* const source, const size_t count)
+{
+    Vector vector = { };
+    std::memcpy(&vector, source, count * sizeof(float));
+    return vector;
+}
+
+__attribute__((always_inline))
+inline void store(float* const destination, const Vector vector, const size_t count)
+{
+    std::memcpy(destination, &vector, count * sizeof(float));
+}
+
+__attribute__((always_inline))
+inline Vector select(const Mask condition, const Vector if_true, const Vector if_false)
+{
+    return condition ? if_true : if_false;
+}
+
+__attribute__((always_inline))
+inline Vector absolute_value(const Vector x)
+{
+    return (Vector) ((Mask) x & 0x7fffffff);
+}
+
+__attribute__((always_inline))
+inline Vector copy_sign(const Vector magnitude, const Vector sign)
+{
+    return (Vector) (((Mask) magnitude & 0x7fffffff) | ((Mask) sign & (std::int32_t) 0x80000000));
+}
+
+// Rounds to the nearest integer, for |x| < 2^22
+__attribute__((always_inline))
+inline Vector round_to_integer(const Vector x)
+{
+    const Vector magic = broadcast(12582912.f);
+    return (x + magic) - magic;
+}
+
+// sin(r) for |r| <= π/2, by its Taylor series up to r^11
+__attribute__((always_inline))
+inline Vector sin_polynomial(const Vector r)
+{
+    const Vector r2 = r * r;
+    Vector p = broadcast(-2.50521083854e-8f);
+    p = p * r2 + 2.75573192240e-6f;
+    p = p * r2 - 1.98412698413e-4f;
+    p = p * r2 + 8.33333333333e-3f;
+    p = p * r2 - 1.66666666667e-1f;
+    return r + r * r2 * p;
+}
+
+// x = r + kπ, so sin(x) = (-1)^k sin(r)
+__attribute__((always_inline))
+inline Vector sin_vector(const Vector x)
+{
+    const Vector k = round_to_integer(x * 0.318309886184f);
+    const Vector r = ((x - k * pi_a) - k * pi_b) - k * pi_c;
+    const Mask odd = __builtin_convertvector(k, Mask) << 31;
+    return (Vector) ((Mask) sin_polynomial(r) ^ odd);
+}
+
+// x = r + (k - 1/2)π, so cos(x) = (-1)^k sin(r)
+__attribute__((always_inline))
+inline Vector cos_vector(const Vector x)
+{
+    const Vector k = round_to_integer(x * 0.318309886184f + 0.5f);
+    const Vector h = k - 0.5f;
+    const Vector r = ((x - h * pi_a) - h * pi_b) - h * pi_c;
+    const Mask odd = __builtin_convertvector(k, Mask) << 31;
+    return (Vector) ((Mask) sin_polynomial(r) ^ odd);
+}
+
+// x = r + k ln(2), so e^x = 2^k e^r, with e^r from the polynomial of Cephes' expf
+__attribute__((always_inline))
+inline Vector exp_vector(const Vector x)
+{
+    Vector clamped = select(x > 88.7f, broadcast(88.7f), x);
+    clamped = select(clamped < -87.f, broadcast(-87.f), clamped);
+
+    const Vector k = round_to_integer(clamped * 1.44269504089f);
+    const Vector r = (clamped - k * ln2_a) - k * ln2_b;
+    const Vector r2 = r * r;
+
+    Vector p = broadcast(1.9875691500e-4f);
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r2 + r + 1.f;
+
+    // 2^k is built as 2^(k-1) * 2 so that k = 128 doesn't overflow the exponent
+    const Mask exponent = __builtin_convertvector(k, Mask) + 126;
+    const Vector result = p * (Vector) (exponent << 23) * 2.f;
+
+    const Vector infinity = broadcast(HUGE_VALF);
+    return select(x > 88.72f, infinity, select(x < -87.f, broadcast(0.f), result));
+}
+
+// x = m 2^e with √½ <= m < √2, so ln(x) = e ln(2) + 2 atanh((m-1)/(m+1))
+__attribute__((always_inline))
+inline Vector log_vector(const Vector x)
+{
+    const Mask subnormal = x < 1.17549435e-38f;
+    const Vector normalised = select(subnormal, x * 8388608.f, x);
+    const Mask bits = (Mask) normalised;
+
+    Mask exponent = ((bits >> 23) & 0xff) - 127 - (subnormal & 23);
+    Vector m = (Vector) ((bits & 0x007fffff) | 0x3f800000);
+
+    const Mask large = m > 1.41421356237f;
+    m = select(large, m * 0.5f, m);
+    exponent -= large;
+
+    const Vector s = (m - 1.f) / (m + 1.f);
+    const Vector s2 = s * s;
+    Vector p = broadcast(1.f / 9.f);
+    p = p * s2 + 1.f / 7.f;
+    p = p * s2 + 1.f / 5.f;
+    p = p * s2 + 1.f / 3.f;
+    p = 2.f * s + 2.f * s * s2 * p;
+
+    const Vector e = __builtin_convertvector(exponent, Vector);
+    Vector result = e * ln2_a + (p + e * ln2_b);
+
+    result = select(x == HUGE_VALF, broadcast(HUGE_VALF), result);
+    result = select(x == 0.f, broadcast(-HUGE_VALF), result);
+    result = select((x < 0.f) | (x != x), broadcast(NAN), result);
+    return result;
+}
+
+// tanh(x) from the polynomial of Cephes' tanhf near zero, and from e^2x further out
+__attribute__((always_inline))
+inline Vector tanh_vector(const Vector x)
+{
+    const Vector ax = absolute_value(x);
+
+    const Vector z = x * x;
+    Vector p = broadcast(-5.70498872745e-3f);
+    p = p * z + 2.06390887954e-2f;
+    p = p * z - 5.37397155531e-2f;
+    p = p * z + 1.33314422036e-1f;
+    p = p * z - 3.33332819422e-1f;
+    const Vector near_zero = p * z * x + x;
+
+    const Vector e = exp_vector(2.f * select(ax > 9.f, broadcast(9.f), ax));
+    const Vector far = copy_sign(1.f - 2.f / (e + 1.f), x);
+
+    return select(ax < 0.625f, near_zero, far);
+}
+
+// atan(x) from the range reduction and polynomial of Cephes' atanf
+__attribute__((always_inline))
+inline Vector atan_vector(const Vector x)
+{
+    const Vector ax = absolute_value(x);
+    const Mask large = ax > 2.41421356237f;
+    const Mask medium = ax > 0.414213562373f;
+
+    const Vector offset = select(large, broadcast(half_pi), select(medium, broadcast(quarter_pi), broadcast(0.f)));
+    const Vector t = select(large, -1.f / ax, select(medium, (ax - 1.f) / (ax + 1.f), ax));
+
+    const Vector z = t * t;
+    Vector p = broadcast(8.05374449538e-2f);
+    p = p * z - 1.38776856032e-1f;
+    p = p * z + 1.99777106478e-1f;
+    p = p * z - 3.33329491539e-1f;
+
+    return copy_sign(offset + p * z * t + t, x);
+}
+
+__attribute__((always_inline))
+inline Vector pow_vector(const Vector x, const Vector y)
+{
+    const Vector magnitude = exp_vector(y * log_vector(absolute_value(x)));
+
+    // A negative base only has a real power when the exponent is an integer
+    const Vector ay = absolute_value(y);
+    const Mask huge = ay >= 8388608.f;
+    const Mask integer = huge | (round_to_integer(y) == y);
+    const Mask odd = ~huge & (__builtin_convertvector(select(huge, broadcast(0.f), y), Mask) << 31);
+
+    const Vector signed_magnitude = (Vector) ((Mask) magnitude ^ odd);
+    Vector result = select(x < 0.f, select(integer, signed_magnitude, broadcast(NAN)), magnitude);
+    return select(y == 0.f || x == 1.f, broadcast(1.f), result);
+}
+
+// sin(2πx) for x in turns. x is reduced to [-1/2, 1/2], then reflected into [-1/4, 1/4]
+__attribute__((always_inline))
+inline Vector sin_turns_vector(const Vector x)
+{
+    Vector r = x - round_to_integer(x);
+    r = select(r > 0.25f, 0.5f - r, r);
+    r = select(r < -0.25f, -0.5f - r, r);
+    return sin_polynomial(r * 6.28318530718f);
+}
+
+// The correction to a unit step at t = 0 (in turns), spread over the sample on either side
+__attribute__((always_inline))
+inline Vector polyblep(const Vector t, const Vector increment)
+{
+    const Vector after = t / increment;
+    const Vector before = (t - 1.f) / increment;
+    const Vector rising = after + after - after * after - 1.f;
+    const Vector falling = before * before + before + before + 1.f;
+    return select(t < increment, rising, select(t > 1.f - increment, falling, broadcast(0.f)));
+}
+
+// Increments of more than half a turn would make the corrections at either end overlap
+__attribute__((always_inline))
+inline Vector step_width(const Vector increment)
+{
+    return select(increment > 0.5f, broadcast(0.5f), increment);
+}
+
+template <typename Function>
+void map(float* const destination, const size_t length, const Function function)
+{
+    size_t n = 0;
+    for (; n + lanes <= length; n += lanes) {
+        store(destination + n, function(n, lanes), lanes);
+    }
+
+    if (n < length) {
+        store(destination + n, function(n, length - n), length - n);
+    }
+}
+
+template <typename Function>
+void map(float* const destination, const float* const source, const size_t length, const Function function)
+{
+    map(destination, length, [&] (const size_t n, const size_t count) {
+        return function(load(source + n, count));
+    });
+}
+
+}
+
+void copy_scaled(float* const destination, const float* const source, const size_t length, const float gain)
+{
+    map(destination, source, length, [gain] (const Vector x) { return x * gain; });
+}
+
+void accumulate(float* const destination, const float* const source, const size_t length, const float gain)
+{
+    map(destination, length, [&] (const size_t n, const size_t count) {
+        return load(destination + n, count) + load(source + n, count) * gain;
+    });
+}
+
+void absolute(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return absolute_value(x); });
+}
+
+void reciprocal(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return 1.f / x; });
+}
+
+void clamp(float* const destination, const float* const source, const size_t length, const float min, const float max)
+{
+    map(destination, source, length, [min, max] (const Vector x) {
+        const Vector lower = select(x < min, broadcast(min), x);
+        return select(max < lower, broadcast(max), lower);
+    });
+}
+
+float dot_product(const float* const a, const float* const b, const size_t length)
+{
+    Vector sum = { };
+    size_t n = 0;
+    for (; n + lanes <= length; n += lanes) {
+        sum += load(a + n, lanes) * load(b + n, lanes);
+    }
+    if (n < length) {
+        sum += load(a + n, length - n) * load(b + n, length - n);
+    }
+
+    float total = 0.f;
+    for (size_t lane = 0; lane < lanes; lane++) total += sum[lane];
+    return total;
+}
+
+float sum(const float* const source, const size_t length)
+{
+    Vector total = { };
+    size_t n = 0;
+    for (; n + lanes <= length; n += lanes) {
+        total += load(source + n, lanes);
+    }
+    if (n < length) {
+        total += load(source + n, length - n);
+    }
+
+    float result = 0.f;
+    for (size_t lane = 0; lane < lanes; lane++) result += total[lane];
+    return result;
+}
+
+void fast_sin(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return sin_vector(x); });
+
+    for (size_t n = 0; n < length; n++) {
+        if (std::fabs(source[n]) >= trigonometric_limit) destination[n] = std::sin(source[n]);
+    }
+}
+
+void fast_cos(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return cos_vector(x); });
+
+    for (size_t n = 0; n < length; n++) {
+        if (std::fabs(source[n]) >= trigonometric_limit) destination[n] = std::cos(source[n]);
+    }
+}
+
+void fast_tanh(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return tanh_vector(x); });
+}
+
+void fast_atan(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return atan_vector(x); });
+}
+
+void fast_exp(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return exp_vector(x); });
+}
+
+void fast_log(float* const destination, const float* const source, const size_t length)
+{
+    map(destination, source, length, [] (const Vector x) { return log_vector(x); });
+}
+
+void fast_pow(float* const destination, const float* const base, const float* const exponent, const size_t length)
+{
+    map(destination, length, [&] (const size_t n, const size_t count) {
+        return pow_vector(load(base + n, count), load(exponent + n, count));
+    });
+}
+
+void fast_pow(float* const destination, const float* const base, const float exponent, const size_t length)
+{
+    map(destination, base, length, [exponent] (const Vector x) { return pow_vector(x, broadcast(exponent)); });
+}
+
+void fast_pow(float* const destination, const float base, const float* const exponent, const size_t length)
+{
+    map(destination, exponent, length, [base] (const Vector y) { return pow_vector(broadcast(base), y); });
+}
+
+void sine_wave(float* const destination, const float* const phases, const size_t length)
+{
+    map(destination, phases, length, [] (const Vector x) { return sin_turns_vector(x); });
+}
+
+void triangle_wave(float* const destination, const float* const phases, const size_t length)
+{
+    map(destination, phases, length, [] (const Vector t) { return 2.f * absolute_value(2.f * t - 1.f) - 1.f; });
+}
+
+void saw_wave(float* const destination, const float* const phases, const float* const increments, const size_t length)
+{
+    map(destination, length, [&] (const size_t n, const size_t count) {
+        const Vector t = load(phases + n, count);
+        const Vector dt = step_width(load(increments + n, count));
+        return 2.f * t - 1.f - polyblep(t, dt);
+    });
+}
+
+void square_wave(float* const destination, const float* const phases, const float* const increments,
+                 const float* const duty_cycles, const size_t length)
+{
+    map(destination, length, [&] (const size_t n, const size_t count) {
+        const Vector t = load(phases + n, count);
+        const Vector dt = step_width(load(increments + n, count));
+        const Vector duty = load(duty_cycles + n, count);
+
+        Vector since_fall = t - duty;
+        since_fall = select(since_fall < 0.f, since_fall + 1.f, since_fall);
+
+        const Vector naive = select(t < duty, broadcast(1.f), broadcast(-1.f));
+        return naive + polyblep(t, dt) - polyblep(since_fall, dt);
+    });
+}
+
+void elementwise_chain(float* const destination, const float* const source,
+                       const std::vector<ElementwiseOperation>& operations, const size_t length)
+{
+    using Kind = ElementwiseOperation::Kind;
+
+    // Each operation is applied to a whole tile of samples before the next, which keeps the
+    // choice of operation out of the inner loops, while the tile stays in registers or close by
+    constexpr size_t tile_vectors = 8;
+    constexpr size_t tile_length = tile_vectors * lanes;
+
+    for (size_t offset = 0; offset < length; offset += tile_length) {
+        const size_t count = std::min(tile_length, length - offset);
+        Vector x[tile_vectors] = { };
+        Vector y[tile_vectors] = { };
+        std::memcpy(x, source + offset, count * sizeof(float));
+
+        for (const ElementwiseOperation& operation : operations) {
+            if (operation.operands) std::memcpy(y, operation.operands + offset, count * sizeof(float));
+            else for (Vector& vector : y) vector = broadcast(operation.operand);
+
+            switch (operation.kind) {
+                case Kind::add:            for (size_t v = 0; v < tile_vectors; v++) x[v] += y[v]; break;
+                case Kind::subtract:       for (size_t v = 0; v < tile_vectors; v++) x[v] -= y[v]; break;
+                case Kind::multiply:       for (size_t v = 0; v < tile_vectors; v++) x[v] *= y[v]; break;
+                case Kind::divide:         for (size_t v = 0; v < tile_vectors; v++) x[v] /= y[v]; break;
+                case Kind::fast_power:     for (size_t v = 0; v < tile_vectors; v++) x[v] = pow_vector(x[v], y[v]); break;
+                case Kind::fast_tanh:      for (size_t v = 0; v < tile_vectors; v++) x[v] = tanh_vector(x[v]); break;
+                case Kind::absolute:       for (size_t v = 0; v < tile_vectors; v++) x[v] = absolute_value(x[v]); break;
+                case Kind::negate:         for (size_t v = 0; v < tile_vectors; v++) x[v] = -x[v]; break;
+                case Kind::reciprocal:     for (size_t v = 0; v < tile_vectors; v++) x[v] = 1.f / x[v]; break;
+                case Kind::bi_to_unipolar: for (size_t v = 0; v < tile_vectors; v++) x[v] = 0.5f + 0.5f * x[v]; break;
+                case Kind::power:
+                    for (size_t n = 0; n < count; n++) x[n / lanes][n % lanes] = std::pow(x[n / lanes][n % lanes], y[n / lanes][n % lanes]);
+                    break;
+                case Kind::tanh:
+                    for (size_t n = 0; n < count; n++) x[n / lanes][n % lanes] = std::tanh(x[n / lanes][n % lanes]);
+                    break;
+            }
+        }
+        std::memcpy(destination + offset, x, count * sizeof(float));
+    }
+}
+
+void BiquadBank::resize(const size_t filters)
+{
+    const size_t padded = (filters + lanes - 1) / lanes * lanes;
+    for (std::vector<float>* array : { &b0, &b1, &b2, &a1, &a2, &b0_step, &b1_step, &b2_step,
+                                       &a1_step, &a2_step, &x1, &x2, &y1, &y2 })
+        array->resize(padded, 0.f);
+}
+
+void biquad_bank(BiquadBank& bank, const float* const* const inputs, float* const* const outputs,
+                 const size_t filters, const size_t length)
+{
+    // Lanes past the last filter read silence, and write somewhere nobody reads
+    static thread_local std::vector<float> silence, discarded;
+    silence.assign(length, 0.f);
+    discarded.resize(length);
+
+    for (size_t first = 0; first < filters; first += lanes) {
+        const float* in[lanes];
+        float* out[lanes];
+        for (size_t lane = 0; lane < lanes; lane++) {
+            in[lane] = first + lane < filters ? inputs[first + lane] : silence.data();
+            out[lane] = first + lane < filters ? outputs[first + lane] : discarded.data();
+        }
+
+        Vector b0 = load(&bank.b0[first], lanes), b1 = load(&bank.b1[first], lanes), b2 = load(&bank.b2[first], lanes);
+        Vector a1 = load(&bank.a1[first], lanes), a2 = load(&bank.a2[first], lanes);
+        const Vector b0_step = load(&bank.b0_step[first], lanes), b1_step = load(&bank.b1_step[first], lanes);
+        const Vector b2_step = load(&bank.b2_step[first], lanes), a1_step = load(&bank.a1_step[first], lanes);
+        const Vector a2_step = load(&bank.a2_step[first], lanes);
+        Vector x1 = load(&bank.x1[first], lanes), x2 = load(&bank.x2[first], lanes);
+        Vector y1 = load(&bank.y1[first], lanes), y2 = load(&bank.y2[first], lanes);
+
+        for (size_t n = 0; n < length; n++) {
+            b0 += b0_step;
+            b1 += b1_step;
+            b2 += b2_step;
+            a1 += a1_step;
+            a2 += a2_step;
+
+            Vector x0;
+            for (size_t lane = 0; lane < lanes; lane++) x0[lane] = in[lane][n];
+            const Vector y0 = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2;
+
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            for (size_t lane = 0; lane < lanes; lane++) out[lane][n] = y0[lane];
+        }
+
+        store(&bank.x1[first], x1, lanes);
+        store(&bank.x2[first], x2, lanes);
+        store(&bank.y1[first], y1, lanes);
+        store(&bank.y2[first], y2, lanes);
+    }
+}
+
+}
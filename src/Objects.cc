@@ -1,42 +1,57 @@
 
 #include <limits>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "Objects.hh"
+#include "Kernels.hh"
 
 namespace Volsung {
 
 void AddObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    process_samples([&] (const size_t n) {
         output_buffer[0][n] = input_buffer[0][n] + default_value;
-    }
+    });
 }
 
 AddObject::AddObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &default_value });
     link_value(&default_value, default_value, 1);
+    enable_in_place_processing();
+}
+
+bool AddObject::is_identity() const
+{
+    return !is_connected(1) && default_value == 0.f;
+}
+
+std::optional<ElementwiseOperation> AddObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::add, default_value };
 }
 
 
 
 void DelayObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    process_samples([&] (const size_t n) {
         delay_buffer[0] = input_buffer[0][n];
 
-        const float lower = delay_buffer[(int) -std::ceil (sample_delay)];
-        const float upper = delay_buffer[(int) -std::floor(sample_delay)];
-        const float ratio = sample_delay - std::floor(sample_delay);
+        // In a feedback loop, the sub-block the loop runs in is part of the delay, so the delay
+        // is held at no less than it
+        const float delay = std::max(sample_delay, latency_compensation) - latency_compensation;
+        const float lower = delay_buffer[(int) -std::ceil (delay)];
+        const float upper = delay_buffer[(int) -std::floor(delay)];
+        const float ratio = delay - std::floor(delay);
 
         output_buffer[0][n] = (1-ratio) * lower + ratio * upper;
         delay_buffer.increment_pointer();
-    }
+    });
 }
 
 DelayObject::DelayObject(const ArgumentList& parameters)
@@ -46,11 +61,68 @@ DelayObject::DelayObject(const ArgumentList& parameters)
     delay_buffer.resize_stream(sample_delay + 10000);
 }
 
+size_t DelayObject::feedback_delay() const
+{
+    // A modulated delay can be driven anywhere, so loops through it only count on a sample of it
+    const size_t delay = (size_t) std::max(0.f, std::floor(sample_delay));
+    return inputs[1].is_connected() ? std::min<size_t>(delay, 1) : delay;
+}
+
+void DelayObject::compensate_feedback_latency(const size_t latency)
+{
+    latency_compensation = (float) latency;
+}
+
+std::optional<ObjectCode> DelayObject::generate_code() const
+{
+    // The buffer is written out from where the next sample goes, so that it starts at the front,
+    // and left to be zeroed when it is silent
+    const size_t size = delay_buffer.size();
+    std::string contents;
+    bool silent = true;
+    for (size_t n = 0; n < size; n++) {
+        contents += (n ? ", " : "") + literal(delay_buffer[(long) n]);
+        silent = silent && delay_buffer[(long) n] == 0.f;
+    }
+
+    ObjectCode code;
+    code.state = { { "float", "buffer", silent ? "{ }" : "{ " + contents + " }", size }, { "int", "position", "0" } };
+    const std::string length = std::to_string(size);
+    const std::string compensation = literal(latency_compensation);
+
+    code.sample = "$buffer[$position] = $in0;\n";
+    if (!is_connected(1)) {
+        const float delay = std::max(sample_delay, latency_compensation) - latency_compensation;
+        const long lower = ((long) -std::ceil(delay) % (long) size + (long) size) % (long) size;
+        const long upper = ((long) -std::floor(delay) % (long) size + (long) size) % (long) size;
+        const float ratio = delay - std::floor(delay);
+
+        code.sample += "$out0 = " + literal(1 - ratio) + " * $buffer[($position + " + std::to_string(lower) + ") % " + length + "]"
+                       " + " + literal(ratio) + " * $buffer[($position + " + std::to_string(upper) + ") % " + length + "];\n";
+    }
+    else code.sample +=
+        "const float $delay = std::max($in1, " + compensation + ") - " + compensation + ";\n"
+        "long $lower = ($position + (int) -std::ceil($delay)) % " + length + ";\n"
+        "long $upper = ($position + (int) -std::floor($delay)) % " + length + ";\n"
+        "if ($lower < 0) $lower += " + length + ";\n"
+        "if ($upper < 0) $upper += " + length + ";\n"
+        "const float $ratio = $delay - std::floor($delay);\n"
+        "$out0 = (1 - $ratio) * $buffer[$lower] + $ratio * $buffer[$upper];\n";
+
+    code.sample += "if (++$position == " + length + ") $position = 0;\n";
+    return code;
+}
+
 
 
 void DriveObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    if (uses_fast_math()) {
+        fast_tanh(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
+        return;
+    }
+
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = std::tanh(input_buffer[0][n]);
     }
 }
@@ -58,14 +130,20 @@ void DriveObject::process(const MultichannelBuffer& input_buffer, MultichannelBu
 DriveObject::DriveObject(const ArgumentList&)
 {
     set_io(2, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> DriveObject::elementwise_operation() const
+{
+    return ElementwiseOperation { uses_fast_math() ? ElementwiseOperation::Kind::fast_tanh : ElementwiseOperation::Kind::tanh };
 }
 
 
 
 void FileoutObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer&)
 {
-    if (pos + AudioBuffer::blocksize >= size) return;
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    if (pos + blocksize() >= size) return;
+    for (size_t n = 0; n < blocksize(); n++) {
         data[pos++] = input_buffer[0][n];
     }
 }
@@ -92,10 +170,15 @@ FileoutObject::FileoutObject(const ArgumentList& parameters)
     set_io(1, 0);
 }
 
+bool FileoutObject::has_side_effects() const
+{
+    return true;
+}
+
 
 void FileinObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         if (pos < data.size()) {
             output_buffer[0][n] = data[pos++];
         }
@@ -120,25 +203,28 @@ FileinObject::FileinObject(const ArgumentList& parameters)
 
 
 
-void FilterObject::process(const MultichannelBuffer& x, MultichannelBuffer& y)
+void FilterObject::calculate_coefficients()
 {
-    update_parameters(0);
     b = 2.0 - std::cos(TAU * frequency / get_sample_rate());
     b = std::sqrt(b*b - 1.0) - b;
     a = 1.0 + b;
+}
 
-    y[0][0] = a*x[0][0] - b*last_value;
+void FilterObject::process(const MultichannelBuffer& x, MultichannelBuffer& y)
+{
+    if (parameters_are_constant()) {
+        calculate_coefficients();
+        for (size_t n = 0; n < blocksize(); n++) {
+            y[0][n] = last_value = a*x[0][n] - b*last_value;
+        }
+        return;
+    }
 
-    for (size_t n = 1; n < AudioBuffer::blocksize; n++) { 
+    for (size_t n = 0; n < blocksize(); n++) {
         update_parameters(n);
-        b = 2.0 - std::cos(TAU * frequency / get_sample_rate());
-        b = sqrt(b*b - 1.0) - b;
-        a = 1.0 + b;
-
-        y[0][n] = a*x[0][n] - b*y[0][n-1];
+        calculate_coefficients();
+        y[0][n] = last_value = a*x[0][n] - b*last_value;
     }
-
-    last_value = y[0][AudioBuffer::blocksize - 1];
 }
 
 FilterObject::FilterObject(const ArgumentList& parameters)
@@ -147,27 +233,58 @@ FilterObject::FilterObject(const ArgumentList& parameters)
     link_value(&frequency, frequency, 1);
 }
 
+std::optional<ObjectCode> FilterObject::generate_code() const
+{
+    ObjectCode code;
+    code.state = { { "double", "last_value", literal(last_value) } };
+
+    if (!is_connected(1)) {
+        double b = 2.0 - std::cos(TAU * frequency / get_sample_rate());
+        b = std::sqrt(b*b - 1.0) - b;
+        code.block_start = "const double $a = " + literal(1.0 + b) + ";\n"
+                           "const double $b = " + literal(b) + ";\n";
+    }
+    else code.sample = "double $b = 2.0 - std::cos(" + literal(TAU) + " * $in1 / " + literal(get_sample_rate()) + ");\n"
+                       "$b = std::sqrt($b * $b - 1.0) - $b;\n"
+                       "const double $a = 1.0 + $b;\n";
+
+    code.sample += "$last_value = $a * $in0 - $b * $last_value;\n"
+                   "$out0 = float($last_value);\n";
+    return code;
+}
+
 
 
 void MultObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    process_samples([&] (const size_t n) {
         output_buffer[0][n] = input_buffer[0][n] * multiplier;
-    }
+    });
 }
 
 MultObject::MultObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &multiplier });
     link_value(&multiplier, multiplier, 1);
+    enable_in_place_processing();
+}
+
+std::optional<float> MultObject::constant_gain() const
+{
+    if (is_connected(1)) return std::nullopt;
+    return multiplier;
+}
+
+std::optional<ElementwiseOperation> MultObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::multiply, multiplier };
 }
 
 
 
 void NoiseObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = distribution(generator);
 }
 
@@ -175,42 +292,124 @@ NoiseObject::NoiseObject(const ArgumentList&) :
     distribution(-1.0f, 1.0f), generator(seed++)
 { set_io(0, 1); }
 
+std::optional<ObjectCode> NoiseObject::generate_code() const
+{
+    // The state of the engine is the number it was last seeded with or gave out
+    std::stringstream engine;
+    engine << generator;
+
+    ObjectCode code;
+    code.state = { { "std::default_random_engine", "generator", "std::default_random_engine(" + engine.str() + "u)" } };
+    code.sample = "$out0 = std::uniform_real_distribution<float>(-1.f, 1.f)($generator);\n";
+    return code;
+}
+
 
 
 void OscillatorObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened)
-            phase = 0;
+    phase.begin_block(blocksize());
+    float* const phases = phase.get_phases();
+
+    if (parameters_are_constant() && !is_connected(1)) {
+        phase.run(frequency);
+        const float offset = phase_offset / TAU;
+        for (size_t n = 0; n < blocksize(); n++) phases[n] += offset;
+    }
 
-        output_buffer[0][n] = std::sin(TAU * phase + phase_offset);
+    else process_samples([&] (const size_t n) {
+        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened) phase.reset();
 
-        phase = phase + frequency / get_sample_rate();
+        phase.step(n, frequency);
+        phases[n] += phase_offset / TAU;
+    });
 
-        if (phase >= 1.0) { phase -= 1.0; }
-    }
+    sine_wave(output_buffer[0].data_pointer(), phases, blocksize());
 }
 
-OscillatorObject::OscillatorObject(const ArgumentList& parameters) :  phase(0)
+OscillatorObject::OscillatorObject(const ArgumentList& parameters)
 {
     init(3, 1, parameters, { &frequency, &phase_offset } );
     link_value(&frequency, frequency, 0);
     link_value(&phase_offset, phase_offset, 2);
 }
 
+// Code setting `$t` to the phase of the sample in turns, as PhaseAccumulator works it out: a block
+// at a time at a constant frequency, or else a sample at a time from the given expression. Band-
+// limited waves also get `$width`, the increment their steps are smoothed over.
+static void add_phase_code(ObjectCode& code, const PhaseAccumulator& phase, const float frequency,
+                           const std::string& modulated, const bool band_limited)
+{
+    code.state.push_back({ "double", "phase", AudioObject::literal(phase.get_phase()) });
 
+    if (modulated.empty()) {
+        double increment = double(frequency) * phase.get_sample_period();
+        const float width = (float) std::fabs(increment);
+        increment -= std::floor(increment);
 
-void SquareObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
+        code.block_start += "const double $increment = " + AudioObject::literal(increment) + ";\n";
+        code.sample += "const double $position = $phase + double($i) * $increment;\n"
+                       "const float $t = float($position - double(std::int32_t($position)));\n";
+        if (band_limited) code.sample += "const float $width = " + AudioObject::literal(width) + ";\n";
+        code.block_end += "$phase += double($n) * $increment;\n"
+                          "$phase -= std::floor($phase);\n";
+        return;
+    }
+
+    code.sample += "const double $increment = double(" + modulated + ") * " + AudioObject::literal(double(phase.get_sample_period())) + ";\n"
+                   "const float $t = float($phase);\n";
+    if (band_limited) code.sample += "const float $width = float(std::fabs($increment));\n";
+    code.sample += "$phase += $increment;\n"
+                   "if ($phase >= 1.0 || $phase < 0.0) $phase -= std::floor($phase);\n";
+}
+
+std::optional<ObjectCode> OscillatorObject::generate_code() const
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-        output_buffer[0][n] = (float) sign<float>(sinf(TAU * phase) + pw);
+    ObjectCode code;
+    code.helpers = { "sin_turns" };
+
+    const bool constant = !is_connected(0) && !is_connected(1) && !is_connected(2);
+    if (!constant) {
+        code.state.push_back({ "float", "gate", literal(sync.get_last_value()) });
+        code.sample = gate_code("$in1") + "if ($opened) $phase = 0;\n";
+    }
+
+    add_phase_code(code, phase, frequency, constant ? "" : parameter_code(0, frequency), false);
+    const std::string offset = constant ? literal(phase_offset / TAU) : parameter_code(2, phase_offset) + " / " + literal(TAU);
+    code.sample += "$out0 = sin_turns($t + " + offset + ");\n";
+    return code;
+}
+
 
-        phase = phase + frequency / get_sample_rate();
 
-        if (phase >= 1.0) { phase -= 1.0; }
+void SquareObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
+{
+    phase.begin_block(blocksize());
+    duty_cycles.resize(blocksize());
+    float* const phases = phase.get_phases();
+
+    // sign(sin(2π phase) + pw) is high for half a period plus asin(pw) / π, starting
+    // asin(pw) / 2π turns before the phase wraps
+    const auto shift_phase = [&] (const size_t n, const float shift) {
+        const float shifted = phases[n] + shift;
+        phases[n] = shifted < 0.f ? shifted + 1.f : (shifted >= 1.f ? shifted - 1.f : shifted);
+    };
+
+    if (parameters_are_constant()) {
+        phase.run(frequency);
+        const float shift = std::asin(std::clamp(pw, -1.f, 1.f)) / TAU;
+        std::fill(duty_cycles.begin(), duty_cycles.end(), 0.5f + 2.f * shift);
+        for (size_t n = 0; n < blocksize(); n++) shift_phase(n, shift);
     }
+
+    else process_samples([&] (const size_t n) {
+        phase.step(n, frequency);
+        const float shift = std::asin(std::clamp(pw, -1.f, 1.f)) / TAU;
+        duty_cycles[n] = 0.5f + 2.f * shift;
+        shift_phase(n, shift);
+    });
+
+    square_wave(output_buffer[0].data_pointer(), phases, phase.get_increments(), duty_cycles.data(), blocksize());
 }
 
 SquareObject::SquareObject(const ArgumentList& parameters)
@@ -220,6 +419,30 @@ SquareObject::SquareObject(const ArgumentList& parameters)
     link_value(&pw, pw, 1);
 }
 
+std::optional<ObjectCode> SquareObject::generate_code() const
+{
+    ObjectCode code;
+    code.helpers = { "polyblep" };
+
+    const bool constant = !is_connected(0) && !is_connected(1);
+    add_phase_code(code, phase, frequency, constant ? "" : parameter_code(0, frequency), true);
+
+    if (!is_connected(1)) {
+        const float shift = std::asin(std::clamp(pw, -1.f, 1.f)) / TAU;
+        code.block_start += "const float $shift = " + literal(shift) + ";\n"
+                            "const float $duty = " + literal(0.5f + 2.f * shift) + ";\n";
+    }
+    else code.sample += "const float $shift = std::asin(std::clamp($in1, -1.f, 1.f)) / " + literal(TAU) + ";\n"
+                        "const float $duty = 0.5f + 2.f * $shift;\n";
+
+    code.sample += "float $shifted = $t + $shift;\n"
+                   "$shifted = $shifted < 0.f ? $shifted + 1.f : ($shifted >= 1.f ? $shifted - 1.f : $shifted);\n"
+                   "float $since_fall = $shifted - $duty;\n"
+                   "$since_fall = $since_fall < 0.f ? $since_fall + 1.f : $since_fall;\n"
+                   "$out0 = ($shifted < $duty ? 1.f : -1.f) + polyblep($shifted, $width) - polyblep($since_fall, $width);\n";
+    return code;
+}
+
 
 
 void UserObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
@@ -236,11 +459,20 @@ UserObject::UserObject(const ArgumentList& parameters, const AudioProcessingCall
     set_io((uint) num_inputs, (uint) num_outputs);
 }
 
+bool UserObject::has_side_effects() const
+{
+    return true;
+}
+
 
 
 void AudioInputObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
 {
-    output_buffer = data;
+    for (size_t channel = 0; channel < output_buffer.size(); channel++) {
+        for (size_t n = 0; n < blocksize(); n++) {
+            output_buffer[channel][n] = channel < data.size() && n < data[channel].size() ? data[channel][n] : 0.f;
+        }
+    }
 }
 
 AudioInputObject::AudioInputObject(const ArgumentList& parameters)
@@ -254,7 +486,12 @@ AudioInputObject::AudioInputObject(const ArgumentList& parameters)
 
 void AudioOutputObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer&)
 {
-    data = input_buffer;
+    for (size_t channel = 0; channel < input_buffer.size(); channel++) {
+        if (data[channel].size() != blocksize()) data[channel] = AudioBuffer(blocksize());
+        for (size_t n = 0; n < blocksize(); n++) {
+            data[channel][n] = input_buffer[channel][n];
+        }
+    }
 }
 
 AudioOutputObject::AudioOutputObject(const ArgumentList& parameters)
@@ -268,24 +505,30 @@ AudioOutputObject::AudioOutputObject(const ArgumentList& parameters)
 
 void ComparatorObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         if (input_buffer[0][n] > value) output_buffer[0][n] = 1.f;
         else output_buffer[0][n] = 0.f;
-    }
+    });
 }
 
 ComparatorObject::ComparatorObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &value });
     link_value(&value, value, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> ComparatorObject::generate_code() const
+{
+    ObjectCode code;
+    code.sample = "$out0 = $in0 > " + parameter_code(1, value) + " ? 1.f : 0.f;\n";
+    return code;
 }
 
 
 void TimerObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         if (reset.read_gate_state(input_buffer[0][n]) & GateState::just_opened) value = 0.f;
 
         output_buffer[0][n] = value;
@@ -298,11 +541,21 @@ TimerObject::TimerObject(const ArgumentList&)
     set_io(1, 1);
 }
 
+std::optional<ObjectCode> TimerObject::generate_code() const
+{
+    ObjectCode code;
+    code.state = { { "float", "value", literal(value) }, { "float", "gate", literal(reset.get_last_value()) } };
+    code.sample = gate_code("$in0") +
+        "if ($opened) $value = 0.f;\n"
+        "$out0 = $value;\n"
+        "$value += " + literal(1.f / get_sample_rate()) + ";\n";
+    return code;
+}
+
 
 void ClockObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    process_samples([&] (const size_t n) {
         if (reset.read_gate_state(input_buffer[1][n]) & GateState::just_opened) {
             elapsed = interval;
         }
@@ -313,7 +566,7 @@ void ClockObject::process(const MultichannelBuffer& input_buffer, MultichannelBu
             output_buffer[0][n] = 1;
         }
         elapsed++;
-    }
+    });
 }
 
 ClockObject::ClockObject(const ArgumentList& parameters)
@@ -323,70 +576,116 @@ ClockObject::ClockObject(const ArgumentList& parameters)
     elapsed = interval;
 }
 
+std::optional<ObjectCode> ClockObject::generate_code() const
+{
+    const std::string interval_code = parameter_code(0, interval);
+
+    ObjectCode code;
+    code.state = { { "float", "elapsed", literal(elapsed) }, { "float", "gate", literal(reset.get_last_value()) } };
+    code.sample = gate_code("$in1") +
+        "if ($opened) $elapsed = " + interval_code + ";\n"
+        "$out0 = 0.f;\n"
+        "if ($elapsed >= " + interval_code + ") {\n"
+        "    $elapsed -= " + interval_code + ";\n"
+        "    $out0 = 1.f;\n"
+        "}\n"
+        "$elapsed++;\n";
+    return code;
+}
+
 
 void DivisionObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         output_buffer[0][n] = input_buffer[0][n] / divisor;
-    }
+    });
 }
 
 DivisionObject::DivisionObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &divisor });
     link_value(&divisor, divisor, 1);
+    enable_in_place_processing();
 }
 
+bool DivisionObject::is_identity() const
+{
+    return !is_connected(1) && divisor == 1.f;
+}
 
-void SubtractionObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
+std::optional<ElementwiseOperation> DivisionObject::elementwise_operation() const
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    return ElementwiseOperation { ElementwiseOperation::Kind::divide, divisor };
+}
+
 
+void SubtractionObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
+{
+    process_samples([&] (const size_t n) {
         output_buffer[0][n] = input_buffer[0][n] - subtrahend;
-    }
+    });
 }
 
 SubtractionObject::SubtractionObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &subtrahend });
     link_value(&subtrahend, subtrahend, 1);
+    enable_in_place_processing();
 }
 
+bool SubtractionObject::is_identity() const
+{
+    return !is_connected(1) && subtrahend == 0.f;
+}
 
-void ModuloObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
+std::optional<ElementwiseOperation> SubtractionObject::elementwise_operation() const
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    return ElementwiseOperation { ElementwiseOperation::Kind::subtract, subtrahend };
+}
+
 
+void ModuloObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
+{
+    process_samples([&] (const size_t n) {
         output_buffer[0][n] = std::fmod(input_buffer[0][n], divisor);
-    }
+    });
 }
 
 ModuloObject::ModuloObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &divisor });
     link_value(&divisor, divisor, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> ModuloObject::generate_code() const
+{
+    ObjectCode code;
+    code.sample = "$out0 = std::fmod($in0, " + parameter_code(1, divisor) + ");\n";
+    return code;
 }
 
 
 void AbsoluteValueObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
-        output_buffer[0][n] = std::fabs(input_buffer[0][n]);
+    absolute(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
 }
 
 AbsoluteValueObject::AbsoluteValueObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> AbsoluteValueObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::absolute };
 }
 
 
 void StepSequence::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         if (step.read_gate_state(input_buffer[0][n]) & GateState::just_opened) {
             current++;
             current %= sequence.size();
@@ -404,17 +703,31 @@ StepSequence::StepSequence(const ArgumentList& parameters)
 
 void PowerObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    if (uses_fast_math()) {
+        float* const output = output_buffer[0].data_pointer();
+        const float* const input = input_buffer[0].data_pointer();
 
-        output_buffer[0][n] = std::pow(input_buffer[0][n], exponent);
+        if (parameters_are_constant()) fast_pow(output, input, exponent, blocksize());
+        else fast_pow(output, input, input_buffer[1].data_pointer(), blocksize());
+        return;
     }
+
+    process_samples([&] (const size_t n) {
+        output_buffer[0][n] = std::pow(input_buffer[0][n], exponent);
+    });
 }
 
 PowerObject::PowerObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &exponent });
     link_value(&exponent, exponent, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> PowerObject::elementwise_operation() const
+{
+    const auto kind = uses_fast_math() ? ElementwiseOperation::Kind::fast_power : ElementwiseOperation::Kind::power;
+    return ElementwiseOperation { kind, exponent };
 }
 
 
@@ -422,9 +735,7 @@ PowerObject::PowerObject(const ArgumentList& parameters)
 
 void EnvelopeObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         if (trigger.read_gate_state(input_buffer[0][n]) & GateState::just_opened) time = 0;
         if (time > length) time = (int) length;
         if (length == 0.f) length = std::numeric_limits<float>::min();
@@ -432,7 +743,7 @@ void EnvelopeObject::process(const MultichannelBuffer& input_buffer, Multichanne
         const float ratio = float(time) / length;
         output_buffer[0][n] = (1-ratio) * start + ratio * end;
         time++;
-    }
+    });
 }
 
 EnvelopeObject::EnvelopeObject(const ArgumentList& parameters)
@@ -444,21 +755,44 @@ EnvelopeObject::EnvelopeObject(const ArgumentList& parameters)
     time = length;
 }
 
+std::optional<ObjectCode> EnvelopeObject::generate_code() const
+{
+    ObjectCode code;
+    code.state = { { "int", "time", std::to_string(time) }, { "float", "gate", literal(trigger.get_last_value()) } };
+    code.sample = gate_code("$in0") +
+        "if ($opened) $time = 0;\n"
+        "float $length = " + parameter_code(1, length) + ";\n"
+        "if ($time > $length) $time = (int) $length;\n"
+        "if ($length == 0.f) $length = " + literal(std::numeric_limits<float>::min()) + ";\n"
+        "const float $ratio = float($time) / $length;\n"
+        "$out0 = (1 - $ratio) * " + parameter_code(2, start) + " + $ratio * " + parameter_code(3, end) + ";\n"
+        "$time++;\n";
+    return code;
+}
+
 void RoundObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = std::round(input_buffer[0][n]);
 }
 
 RoundObject::RoundObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> RoundObject::generate_code() const
+{
+    ObjectCode code;
+    code.sample = "$out0 = std::round($in0);\n";
+    return code;
 }
 
 
 void SequenceObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         float index = std::max(0.f, input_buffer[0][n]);
         if (index >= sequence.size()) index = sequence.size() - 1;
 
@@ -479,7 +813,7 @@ SequenceObject::SequenceObject(const ArgumentList& parameters)
 
 void SampleAndHoldObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         if (trigger.read_gate_state(input_buffer[1][n]) & GateState::just_opened) value = input_buffer[0][n];
         output_buffer[0][n] = value;
     }
@@ -490,10 +824,20 @@ SampleAndHoldObject::SampleAndHoldObject(const ArgumentList&)
     set_io(2, 1);
 }
 
+std::optional<ObjectCode> SampleAndHoldObject::generate_code() const
+{
+    ObjectCode code;
+    code.state = { { "float", "value", literal(value) }, { "float", "gate", literal(trigger.get_last_value()) } };
+    code.sample = gate_code("$in1") +
+        "if ($opened) $value = $in0;\n"
+        "$out0 = $value;\n";
+    return code;
+}
+
 
 void ConstObject::process(const MultichannelBuffer&, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = value;
 }
 
@@ -503,20 +847,25 @@ ConstObject::ConstObject(const ArgumentList& parameters)
     set_io(0, 1);
 }
 
+bool ConstObject::is_pure() const
+{
+    return true;
+}
+
 
 void SawObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    phase.begin_block(blocksize());
 
-        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened) phase = -1;
+    if (parameters_are_constant() && !is_connected(1)) phase.run(frequency);
 
-        phase += std::abs(2.f * frequency / get_sample_rate());
-        if (phase > 1.f) phase = -1.f;
+    else process_samples([&] (const size_t n) {
+        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened) phase.reset();
+        phase.step(n, frequency);
+    });
 
-        if (frequency < 0) output_buffer[0][n] = -phase;
-        else output_buffer[0][n] = phase;
-    }
+    // A negative frequency runs the phase backwards, which gives a falling ramp
+    saw_wave(output_buffer[0].data_pointer(), phase.get_phases(), phase.get_increments(), blocksize());
 }
 
 SawObject::SawObject(const ArgumentList& parameters)
@@ -525,17 +874,34 @@ SawObject::SawObject(const ArgumentList& parameters)
     link_value(&frequency, frequency, 0);
 }
 
+std::optional<ObjectCode> SawObject::generate_code() const
+{
+    ObjectCode code;
+    code.helpers = { "polyblep" };
+
+    const bool constant = !is_connected(0) && !is_connected(1);
+    if (!constant) {
+        code.state.push_back({ "float", "gate", literal(sync.get_last_value()) });
+        code.sample = gate_code("$in1") + "if ($opened) $phase = 0;\n";
+    }
+
+    add_phase_code(code, phase, frequency, constant ? "" : parameter_code(0, frequency), true);
+    code.sample += "$out0 = 2.f * $t - 1.f - polyblep($t, $width);\n";
+    return code;
+}
+
 void TriangleObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    phase.begin_block(blocksize());
 
-        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened) phase = 0;
+    if (parameters_are_constant() && !is_connected(1)) phase.run(frequency);
 
-        phase += frequency / get_sample_rate();
-        if (phase >= 1.f) phase -= 1.f;
-        output_buffer[0][n] = 2.f * fabs(2.f * phase - 1.f) - 1.f;
-    }
+    else process_samples([&] (const size_t n) {
+        if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened) phase.reset();
+        phase.step(n, frequency);
+    });
+
+    triangle_wave(output_buffer[0].data_pointer(), phase.get_phases(), blocksize());
 }
 
 TriangleObject::TriangleObject(const ArgumentList& parameters)
@@ -544,72 +910,193 @@ TriangleObject::TriangleObject(const ArgumentList& parameters)
     link_value(&frequency, frequency, 0);
 }
 
+std::optional<ObjectCode> TriangleObject::generate_code() const
+{
+    ObjectCode code;
+
+    const bool constant = !is_connected(0) && !is_connected(1);
+    if (!constant) {
+        code.state.push_back({ "float", "gate", literal(sync.get_last_value()) });
+        code.sample = gate_code("$in1") + "if ($opened) $phase = 0;\n";
+    }
+
+    add_phase_code(code, phase, frequency, constant ? "" : parameter_code(0, frequency), false);
+    code.sample += "$out0 = 2.f * std::fabs(2.f * $t - 1.f) - 1.f;\n";
+    return code;
+}
+
+void BiquadObject::update_coefficients()
+{
+    if (!resonance) resonance = std::numeric_limits<float>::min();
+    if (frequency == coefficient_frequency && resonance == coefficient_resonance) return;
+
+    coefficients = coefficients_for(frequency, resonance);
+    coefficient_frequency = frequency;
+    coefficient_resonance = resonance;
+}
+
+BiquadObject::Coefficients BiquadObject::coefficients_for(const float frequency, const float resonance) const
+{
+    const float omega = TAU * frequency / get_sample_rate();
+    const float alpha = std::sin(omega) / (2.f * resonance);
+    const float cos_omega = std::cos(omega);
+
+    const Design design = calculate_coefficients(alpha, cos_omega, resonance);
+    return { design.b0 / design.a0, design.b1 / design.a0, design.b2 / design.a0, design.a1 / design.a0, design.a2 / design.a0 };
+}
+
+BiquadObject::Coefficients BiquadObject::block_coefficients(Coefficients& step)
+{
+    // With modulated parameters, the coefficients are calculated for the end of the block and
+    // interpolated towards from where the last block left them
+    const bool interpolate = !parameters_are_constant() && !std::isnan(coefficient_frequency);
+    const Coefficients start = coefficients;
+    if (!parameters_are_constant()) update_parameters(blocksize() - 1);
+    update_coefficients();
+
+    step = { 0, 0, 0, 0, 0 };
+    if (!interpolate) return coefficients;
+
+    const float scale = 1.f / blocksize();
+    step = { (coefficients.b0 - start.b0) * scale, (coefficients.b1 - start.b1) * scale,
+             (coefficients.b2 - start.b2) * scale, (coefficients.a1 - start.a1) * scale,
+             (coefficients.a2 - start.a2) * scale };
+    return start;
+}
+
 void BiquadObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    Coefficients step;
+    Coefficients c = block_coefficients(step);
 
-        if (!resonance) resonance = std::numeric_limits<float>::min();
-        omega = TAU * frequency / get_sample_rate();
-        alpha = std::sin(omega) / (2.f * resonance);
-        cos_omega = std::cos(omega);
+    for (size_t n = 0; n < blocksize(); n++) {
+        c.b0 += step.b0;
+        c.b1 += step.b1;
+        c.b2 += step.b2;
+        c.a1 += step.a1;
+        c.a2 += step.a2;
 
-        calculate_coefficients();
+        const float x0 = input_buffer[0][n];
+        const float y0 = c.b0*x0 + c.b1*x1 + c.b2*x2 - c.a1*y1 - c.a2*y2;
 
-        x[0] = input_buffer[0][n];
-        output_buffer[0][n] = y[0] = (b0*x[0] + b1*x[-1] + b2*x[-2] - a1*y[-1] - a2*y[-2]) / a0;
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        output_buffer[0][n] = y0;
+    }
+}
 
-        x.increment_pointer();
-        y.increment_pointer();
+std::optional<ObjectCode> BiquadObject::generate_code() const
+{
+    // Modulated coefficients are interpolated towards those of the last sample of the block,
+    // which the code of a sample can't read ahead to
+    if (is_connected(1) || is_connected(2)) return std::nullopt;
+
+    const Coefficients c = coefficients_for(frequency, resonance ? resonance : std::numeric_limits<float>::min());
+
+    ObjectCode code;
+    code.state = { { "float", "x1", literal(x1) }, { "float", "x2", literal(x2) },
+                   { "float", "y1", literal(y1) }, { "float", "y2", literal(y2) } };
+    code.block_start = "const float $b0 = " + literal(c.b0) + ";\n"
+                       "const float $b1 = " + literal(c.b1) + ";\n"
+                       "const float $b2 = " + literal(c.b2) + ";\n"
+                       "const float $a1 = " + literal(c.a1) + ";\n"
+                       "const float $a2 = " + literal(c.a2) + ";\n";
+    code.sample = "const float $x0 = $in0;\n"
+                  "const float $y0 = $b0 * $x0 + $b1 * $x1 + $b2 * $x2 - $a1 * $y1 - $a2 * $y2;\n"
+                  "$x2 = $x1;\n"
+                  "$x1 = $x0;\n"
+                  "$y2 = $y1;\n"
+                  "$y1 = $y0;\n"
+                  "$out0 = $y0;\n";
+    return code;
+}
+
+std::unique_ptr<ObjectGroup> BiquadObject::make_group() const
+{
+    return std::make_unique<BiquadGroup>();
+}
+
+bool BiquadGroup::accepts(const AudioObject* const object) const
+{
+    return dynamic_cast<const BiquadObject*>(object);
+}
+
+void BiquadGroup::add(AudioObject* const member)
+{
+    // The group takes over the state of its members while it runs them, and hands it back after
+    // each block
+    const BiquadObject* const biquad = static_cast<BiquadObject*>(member);
+    const size_t index = member_inputs.size();
+    member_inputs.push_back(nullptr);
+    member_outputs.push_back(nullptr);
+
+    bank.resize(member_inputs.size());
+    bank.x1[index] = biquad->x1;
+    bank.x2[index] = biquad->x2;
+    bank.y1[index] = biquad->y1;
+    bank.y2[index] = biquad->y2;
+}
+
+void BiquadGroup::process_members(const std::vector<AudioObject*>& members, const size_t length)
+{
+    for (size_t n = 0; n < members.size(); n++) {
+        BiquadObject* const biquad = static_cast<BiquadObject*>(members[n]);
+        BiquadObject::Coefficients step;
+        const BiquadObject::Coefficients start = biquad->block_coefficients(step);
+
+        bank.b0[n] = start.b0;
+        bank.b1[n] = start.b1;
+        bank.b2[n] = start.b2;
+        bank.a1[n] = start.a1;
+        bank.a2[n] = start.a2;
+        bank.b0_step[n] = step.b0;
+        bank.b1_step[n] = step.b1;
+        bank.b2_step[n] = step.b2;
+        bank.a1_step[n] = step.a1;
+        bank.a2_step[n] = step.a2;
+
+        member_inputs[n] = input_of(biquad, 0);
+        member_outputs[n] = output_of(biquad, 0);
+    }
+
+    biquad_bank(bank, member_inputs.data(), member_outputs.data(), members.size(), length);
+
+    for (size_t n = 0; n < members.size(); n++) {
+        BiquadObject* const biquad = static_cast<BiquadObject*>(members[n]);
+        biquad->x1 = bank.x1[n];
+        biquad->x2 = bank.x2[n];
+        biquad->y1 = bank.y1[n];
+        biquad->y2 = bank.y2[n];
     }
 }
 
 BiquadObject::BiquadObject(const ArgumentList& parameters)
-: x(4), y(4)
 {
     init(3, 1, parameters, { &frequency, &resonance });
     link_value(&frequency, frequency, 1);
     link_value(&resonance, resonance, 2);
 }
 
-void LowpassObject::calculate_coefficients()
+BiquadObject::Design LowpassObject::calculate_coefficients(const float alpha, const float cos_omega, const float) const
 {
-    a0 = 1 + alpha;
-    a1 = -2 * cos_omega;
-    a2 = 1 - alpha;
-    b0 = (1 - cos_omega) / 2;
-    b1 = 1 - cos_omega;
-    b2 = b0;
+    return { 1 + alpha, -2 * cos_omega, 1 - alpha, (1 - cos_omega) / 2, 1 - cos_omega, (1 - cos_omega) / 2 };
 }
 
-void HighpassObject::calculate_coefficients()
+BiquadObject::Design HighpassObject::calculate_coefficients(const float alpha, const float cos_omega, const float) const
 {
-    a0 = 1 + alpha;
-    a1 = -2 * cos_omega;
-    a2 = 1 - alpha;
-    b0 = (1 + cos_omega) / 2;
-    b1 = -(1 + cos_omega);
-    b2 = b0;
+    return { 1 + alpha, -2 * cos_omega, 1 - alpha, (1 + cos_omega) / 2, -(1 + cos_omega), (1 + cos_omega) / 2 };
 }
 
-void BandpassObject::calculate_coefficients()
+BiquadObject::Design BandpassObject::calculate_coefficients(const float alpha, const float cos_omega, const float resonance) const
 {
-    a0 = 1 + alpha;
-    a1 = -2 * cos_omega;
-    a2 = 1 - alpha;
-    b0 = resonance * alpha;
-    b1 = 0;
-    b2 = -resonance * alpha;
+    return { 1 + alpha, -2 * cos_omega, 1 - alpha, resonance * alpha, 0, -resonance * alpha };
 }
 
-void AllpassObject::calculate_coefficients()
+BiquadObject::Design AllpassObject::calculate_coefficients(const float alpha, const float cos_omega, const float) const
 {
-    a0 = 1 + alpha;
-    a1 = -2 * cos_omega;
-    a2 = 1 - alpha;
-    b0 = 1 - alpha;
-    b1 = -2 * cos_omega;
-    b2 = 1 + alpha;
+    return { 1 + alpha, -2 * cos_omega, 1 - alpha, 1 - alpha, -2 * cos_omega, 1 + alpha };
 }
 
 
@@ -617,9 +1104,7 @@ void AllpassObject::calculate_coefficients()
 
 void EnvelopeFollowerObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         const float sample = std::fabs(input_buffer[0][n]);
 
         const float internal_attack = std::exp(time_constant / attack);
@@ -635,7 +1120,7 @@ void EnvelopeFollowerObject::process(const MultichannelBuffer& input_buffer, Mul
 
         last_value = detector_value;
         output_buffer[0][n] = detector_value;
-    }
+    });
 }
 
 EnvelopeFollowerObject::EnvelopeFollowerObject(const ArgumentList& parameters)
@@ -645,9 +1130,27 @@ EnvelopeFollowerObject::EnvelopeFollowerObject(const ArgumentList& parameters)
     link_value(&release, release, 2);
 }
 
+std::optional<ObjectCode> EnvelopeFollowerObject::generate_code() const
+{
+    const auto rate = [this] (const uint input, const float time) {
+        return is_connected(input) ? "std::exp(" + literal(time_constant) + " / $in" + std::to_string(input) + ")"
+                                   : literal(std::exp(time_constant / time));
+    };
+
+    ObjectCode code;
+    code.state = { { "float", "last_value", literal(last_value) } };
+    code.sample = "const float $sample = std::fabs($in0);\n"
+                  "const float $rate = $sample > $last_value ? " + rate(1, attack) + " : " + rate(2, release) + ";\n"
+                  "float $detector_value = $rate * ($last_value - $sample) + $sample;\n"
+                  "if ($detector_value < 0.f) $detector_value = 0.f;\n"
+                  "$last_value = $detector_value;\n"
+                  "$out0 = $detector_value;\n";
+    return code;
+}
+
 void SubgraphObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    output_buffer = graph->run(input_buffer);
+    output_buffer = graph->run(input_buffer, blocksize());
 }
 
 SubgraphObject::SubgraphObject(const ArgumentList& parameters)
@@ -657,33 +1160,29 @@ SubgraphObject::SubgraphObject(const ArgumentList& parameters)
     set_io(num_inputs, num_outputs);
 }
 
+bool SubgraphObject::has_side_effects() const
+{
+    return graph->has_side_effects();
+}
+
 void ConvolveObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        signal[0] = input_buffer[0][n];
-        
-        float value = 0;
-        for (size_t i = 0; i < impulse_response.size(); i++) {
-            value += impulse_response[i] * signal[(long) i-1];
-        }
-        output_buffer[0][n] = value;
-        signal.increment_pointer();
-    }
+    convolution->process(input_buffer[0].data_pointer(), output_buffer[0].data_pointer(), blocksize());
 }
 
 ConvolveObject::ConvolveObject(const ArgumentList& parameters)
 {
     set_io(1, 1);
-    impulse_response = parameters[0].get_value<Sequence>();
-    signal.resize_stream(impulse_response.size());
+
+    const Sequence& impulse_response = parameters[0].get_value<Sequence>();
+    const std::vector<float> taps(impulse_response.real_data(), impulse_response.real_data() + impulse_response.size());
+    convolution = std::make_unique<Convolution>(taps);
 }
 
 
 void PoleObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         if (position.imag() == 0.f) {
             a2 = 0;
             a1 = -position.real();
@@ -695,7 +1194,7 @@ void PoleObject::process(const MultichannelBuffer& input_buffer, MultichannelBuf
 
         output_buffer[0][n] = y[0] = input_buffer[0][n] - a1*y[-1] - a2*y[-2];
         y.increment_pointer();
-    }
+    });
 }
 
 PoleObject::PoleObject(const ArgumentList& parameters)
@@ -711,16 +1210,14 @@ PoleObject::PoleObject(const ArgumentList& parameters)
 
 void ZeroObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-
+    process_samples([&] (const size_t n) {
         b1 = -2.f * position.magnitude() * std::cos(position.angle());
         b2 = position.magnitude() * position.magnitude();
         
         x[0] = input_buffer[0][n];
         output_buffer[0][n] = x[0] + b1*x[-1] + b2*x[-2];
         x.increment_pointer();
-    }
+    });
 }
 
 ZeroObject::ZeroObject(const ArgumentList& parameters)
@@ -735,13 +1232,19 @@ ZeroObject::ZeroObject(const ArgumentList& parameters)
 
 void BiToUnipolarObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = 0.5f + 0.5f * input_buffer[0][n];
 }
 
 BiToUnipolarObject::BiToUnipolarObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> BiToUnipolarObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::bi_to_unipolar };
 }
 
 
@@ -750,43 +1253,87 @@ BiToUnipolarObject::BiToUnipolarObject(const ArgumentList&)
 
 void CeilObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = std::ceil(input_buffer[0][n]);
 }
 
 CeilObject::CeilObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> CeilObject::generate_code() const
+{
+    ObjectCode code;
+    code.sample = "$out0 = std::ceil($in0);\n";
+    return code;
 }
 
 void SinObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    if (uses_fast_math()) {
+        fast_sin(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
+        return;
+    }
+
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = std::sin(input_buffer[0][n]);
+    }
 }
 
 SinObject::SinObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> SinObject::generate_code() const
+{
+    if (uses_fast_math()) return std::nullopt;
+
+    ObjectCode code;
+    code.sample = "$out0 = std::sin($in0);\n";
+    return code;
 }
 
 void CosObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    if (uses_fast_math()) {
+        fast_cos(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
+        return;
+    }
+
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = std::cos(input_buffer[0][n]);
+    }
 }
 
 CosObject::CosObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> CosObject::generate_code() const
+{
+    if (uses_fast_math()) return std::nullopt;
+
+    ObjectCode code;
+    code.sample = "$out0 = std::cos($in0);\n";
+    return code;
 }
 
 void ClampObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-        output_buffer[0][n] = std::clamp(input_buffer[0][n], min, max);
+    if (parameters_are_constant()) {
+        clamp(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize(), min, max);
+        return;
     }
+
+    process_samples([&] (const size_t n) {
+        output_buffer[0][n] = std::clamp(input_buffer[0][n], min, max);
+    });
 }
 
 ClampObject::ClampObject(const ArgumentList& parameters)
@@ -794,29 +1341,51 @@ ClampObject::ClampObject(const ArgumentList& parameters)
     init(3, 1, parameters, { &min, &max });
     link_value(&min, min, 1);
     link_value(&max, max, 2);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> ClampObject::generate_code() const
+{
+    ObjectCode code;
+    if (!is_connected(1) && !is_connected(2))
+        code.sample = "const float $lower = $in0 < " + literal(min) + " ? " + literal(min) + " : $in0;\n"
+                      "$out0 = " + literal(max) + " < $lower ? " + literal(max) + " : $lower;\n";
+    else code.sample = "$out0 = std::clamp($in0, " + parameter_code(1, min) + ", " + parameter_code(2, max) + ");\n";
+    return code;
 }
 
 
 void ReciprocalObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
-        output_buffer[0][n] = 1.f / input_buffer[0][n];
+    reciprocal(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
 }
 
 ReciprocalObject::ReciprocalObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> ReciprocalObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::reciprocal };
 }
 
 void InverseObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++)
+    for (size_t n = 0; n < blocksize(); n++)
         output_buffer[0][n] = -input_buffer[0][n];
 }
 
 InverseObject::InverseObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ElementwiseOperation> InverseObject::elementwise_operation() const
+{
+    return ElementwiseOperation { ElementwiseOperation::Kind::negate };
 }
 
 
@@ -826,7 +1395,7 @@ InverseObject::InverseObject(const ArgumentList&)
 
 void SignObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = input_buffer[0][n] >= 0 ? 1 : -1;
     }
 }
@@ -834,39 +1403,68 @@ void SignObject::process(const MultichannelBuffer& input_buffer, MultichannelBuf
 SignObject::SignObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
+}
+
+std::optional<ObjectCode> SignObject::generate_code() const
+{
+    ObjectCode code;
+    code.sample = "$out0 = $in0 >= 0 ? 1.f : -1.f;\n";
+    return code;
 }
 
 void LogarithmObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-        output_buffer[0][n] = std::log(input_buffer[0][n]) / std::log(base);
+    if (uses_fast_math() && parameters_are_constant()) {
+        float* const output = output_buffer[0].data_pointer();
+        fast_log(output, input_buffer[0].data_pointer(), blocksize());
+        copy_scaled(output, output, blocksize(), 1.f / std::log(base));
+        return;
     }
+
+    process_samples([&] (const size_t n) {
+        output_buffer[0][n] = std::log(input_buffer[0][n]) / std::log(base);
+    });
 }
 
 LogarithmObject::LogarithmObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &base });
     link_value(&base, base, 1);
+    enable_in_place_processing();
 }
 
 void ExponentialObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
-        output_buffer[0][n] = std::pow(base, input_buffer[0][n]);
+    if (uses_fast_math()) {
+        float* const output = output_buffer[0].data_pointer();
+        const float* const input = input_buffer[0].data_pointer();
+
+        if (parameters_are_constant()) fast_pow(output, base, input, blocksize());
+        else fast_pow(output, input_buffer[1].data_pointer(), input, blocksize());
+        return;
     }
+
+    process_samples([&] (const size_t n) {
+        output_buffer[0][n] = std::pow(base, input_buffer[0][n]);
+    });
 }
 
 ExponentialObject::ExponentialObject(const ArgumentList& parameters)
 {
     init(2, 1, parameters, { &base });
     link_value(&base, base, 1);
+    enable_in_place_processing();
 }
 
 void AtanObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    if (uses_fast_math()) {
+        fast_atan(output_buffer[0].data_pointer(), input_buffer[0].data_pointer(), blocksize());
+        return;
+    }
+
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = std::atan(input_buffer[0][n]);
     }
 }
@@ -874,21 +1472,21 @@ void AtanObject::process(const MultichannelBuffer& input_buffer, MultichannelBuf
 AtanObject::AtanObject(const ArgumentList&)
 {
     set_io(1, 1);
+    enable_in_place_processing();
 }
 
 
 
 void PhasorObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        update_parameters(n);
+    process_samples([&] (const size_t n) {
         if (sync.read_gate_state(input_buffer[1][n]) & GateState::just_opened)
             phase = 0;
 
         output_buffer[0][n] = phase;
         phase += 1.0 / period;
         if (phase - phase_offset >= 1.0) { phase -= 1.0 - phase_offset; }
-    }
+    });
 }
 
 PhasorObject::PhasorObject(const ArgumentList& parameters) :  phase(0)
@@ -898,11 +1496,25 @@ PhasorObject::PhasorObject(const ArgumentList& parameters) :  phase(0)
     link_value(&phase_offset, phase_offset, 2);
 }
 
+std::optional<ObjectCode> PhasorObject::generate_code() const
+{
+    ObjectCode code;
+    code.state = { { "double", "phase", literal(phase) }, { "float", "gate", literal(sync.get_last_value()) } };
+
+    const std::string offset = parameter_code(2, phase_offset);
+    code.sample = gate_code("$in1") +
+        "if ($opened) $phase = 0;\n"
+        "$out0 = float($phase);\n"
+        "$phase += 1.0 / " + parameter_code(0, period) + ";\n"
+        "if ($phase - " + offset + " >= 1.0) { $phase -= 1.0 - " + offset + "; }\n";
+    return code;
+}
+
 
 
 void InvokeObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = function({ (Number) input_buffer[0][n] }, nullptr).get_value<Number>();
     }
 }
@@ -915,13 +1527,18 @@ InvokeObject::InvokeObject(const ArgumentList& parameters)
 
 void InvokeBlockwiseObject::process(const MultichannelBuffer& input_buffer, MultichannelBuffer& output_buffer)
 {
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
-        block[n] = input_buffer[0][n];
+    while (block.size() < blocksize()) {
+        indeces.add_element(block.size());
+        block.add_element(0);
+    }
+
+    for (size_t n = 0; n < blocksize(); n++) {
+        block.set(n, input_buffer[0][n]);
     }
 
     //block = function({ block, indeces }, nullptr).get_value<Sequence>();
 
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) {
+    for (size_t n = 0; n < blocksize(); n++) {
         output_buffer[0][n] = block[n];
     }
 }
@@ -930,9 +1547,6 @@ InvokeBlockwiseObject::InvokeBlockwiseObject(const ArgumentList& parameters)
 {
     set_io(1, 1);
     function = parameters[0].get_value<Procedure>().implementation;
-
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) block.add_element(0);
-    for (size_t n = 0; n < AudioBuffer::blocksize; n++) indeces.add_element(n);
 }
 
 }
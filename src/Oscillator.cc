@@ -0,0 +1,76 @@
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "Oscillator.hh"
+#include "VolsungCore.hh"
+
+namespace Volsung {
+
+PhaseAccumulator::PhaseAccumulator() : sample_period(get_sample_period())
+{ }
+
+void PhaseAccumulator::begin_block(const size_t length)
+{
+    // Read each block, as the sample rate may be set after the oscillator is made
+    sample_period = get_sample_period();
+    phases.resize(length);
+    increments.resize(length);
+}
+
+void PhaseAccumulator::run(const float frequency)
+{
+    const size_t length = phases.size();
+    double increment = double(frequency) * sample_period;
+    std::fill(increments.begin(), increments.end(), (float) std::fabs(increment));
+
+    // Frequencies above the sample rate alias to the same phases as ones below it
+    increment -= std::floor(increment);
+
+    for (size_t n = 0; n < length; n++) {
+        const double position = phase + double(n) * increment;
+        const double wrapped = position - double(std::int32_t(position));
+        phases[n] = float(wrapped);
+    }
+
+    phase += double(length) * increment;
+    phase -= std::floor(phase);
+}
+
+void PhaseAccumulator::step(const size_t n, const float frequency)
+{
+    const double increment = double(frequency) * sample_period;
+    phases[n] = float(phase);
+    increments[n] = (float) std::fabs(increment);
+
+    phase += increment;
+    if (phase >= 1.0 || phase < 0.0) phase -= std::floor(phase);
+}
+
+void PhaseAccumulator::reset(const double initial_phase)
+{
+    phase = initial_phase;
+}
+
+float* PhaseAccumulator::get_phases()
+{
+    return phases.data();
+}
+
+const float* PhaseAccumulator::get_increments() const
+{
+    return increments.data();
+}
+
+double PhaseAccumulator::get_phase() const
+{
+    return phase;
+}
+
+float PhaseAccumulator::get_sample_period() const
+{
+    return 1.f / get_sample_rate();
+}
+
+}
@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include "Parser.hh"
 
 namespace Volsung {
@@ -9,136 +11,123 @@ const char* VolsungException::what() const noexcept
 }
 
 
-Token Lexer::get_next_token()
+Token Lexer::lex_token()
 {
-    position++;
-    if (current() == '\r') position++;
-    if (current() == EOF || current() == -1) return { TokenType::eof, "" };
+    // Skips spaces, comments, and line breaks escaped with a backslash
+    while (true) {
+        while (current() == ' ' || current() == '\t' || current() == '\r') cursor++;
+        if (current() == ';') while (current() != '\n' && current() != EOF) cursor++;
 
-    while (current() == ' ' || current() == '\t') position++;
-    if (current() == ';') while (current() != '\n') position++;
+        if (current() != '\\') break;
+        cursor++;
+        if (current() == '\n') {
+            line++;
+            line_start = cursor + 1;
+        }
+        cursor++;
+    }
+
+    const size_t start = cursor;
+    const uint32_t start_line = line;
+    const uint32_t start_column = start - line_start + 1;
+
+    // Makes a token of the text `length` characters long after the first `skip`, and moves past it
+    const auto token = [&] (const TokenType type, const size_t length = 0, const size_t skip = 0) {
+        cursor = start + skip + length;
+        return Token { type, std::string_view(source_code).substr(start + skip, length), start_line, start_column, (uint32_t) start };
+    };
+
+    const auto next_is = [this, start] (const char character) {
+        return start + 1 < source_code.size() && source_code[start + 1] == character;
+    };
 
     switch (current()) {
-        case '\n':
+        case EOF:
+            return token(TokenType::eof);
+
+        case '\n': {
+            const Token newline = token(TokenType::newline, 0, 1);
             line++;
-            return { TokenType::newline, "" };
+            line_start = cursor;
+            return newline;
+        }
 
         case '-':
-            position++;
-            if (current() == '>') return { TokenType::arrow, "" };
-            if (current() == '-') {
-                position++;
-                if (current() == '>') return { TokenType::series, "" };
-                position--;
-            }
-            position--;
-            return { TokenType::minus, "" };
-
-        case '>':
-            position++;
-            if (current() == '>') return { TokenType::many_to_one, "" };
-            position--;
-            return { TokenType::greater_than, "" };
-
-        case '<':
-            position++;
-            if (current() == '>') return { TokenType::one_to_many, "" };
-            position--;
-            return { TokenType::less_than, "" };
-
-        case '=':
-            position++;
-            if (current() == '>') return { TokenType::parallel, "" };
-            position--;
-            return { TokenType::invalid, "" };
+            if (next_is('>')) return token(TokenType::arrow, 0, 2);
+            if (next_is('-') && start + 2 < source_code.size() && source_code[start + 2] == '>')
+                return token(TokenType::series, 0, 3);
+            return token(TokenType::minus, 0, 1);
+
+        case '>': return token(next_is('>') ? TokenType::many_to_one : TokenType::greater_than, 0, next_is('>') ? 2 : 1);
+        case '<': return token(next_is('>') ? TokenType::one_to_many : TokenType::less_than, 0, next_is('>') ? 2 : 1);
+        case '=': return token(next_is('>') ? TokenType::parallel : TokenType::invalid, 0, next_is('>') ? 2 : 1);
+        case '.': return token(next_is('.') ? TokenType::elipsis : TokenType::dot, 0, next_is('.') ? 2 : 1);
 
         case 'x':
-            position++;
-            if (current() == '>') return { TokenType::cross_connection, "" };
-            position--;
+            if (next_is('>')) return token(TokenType::cross_connection, 0, 2);
             break;
 
-        case '.':
-            position++;
-            if (current() == '.') return { TokenType::elipsis, "" };
-            position--;
-            return { TokenType::dot, "" };
-
-        case '{':  return { TokenType::open_brace, "" };
-        case '}':  return { TokenType::close_brace, "" };
-        case '(':  return { TokenType::open_paren, "" };
-        case ')':  return { TokenType::close_paren, "" };
-        case '[':  return { TokenType::open_bracket, "" };
-        case ']':  return { TokenType::close_bracket, "" };
-        case ':':  return { TokenType::colon, "" };
-        case ',':  return { TokenType::comma, "" };
-        case '&':  return { TokenType::ampersand, "" };
-        case '%':  return { TokenType::percent, "" };
-        case '`':  return { TokenType::backtick, "" };
-        case '*':  return { TokenType::asterisk, "" };
-        case '+':  return { TokenType::plus, "" };
-        case '/':  return { TokenType::slash, "" };
-        case '^':  return { TokenType::caret, "" };
-        case '|':  return { TokenType::vertical_bar, "" };
-
-        case '\\': {
-            position++;
-            if (current() == '\n') line++;
-            return get_next_token();
-        }
-    }
-
+        case '{':  return token(TokenType::open_brace, 0, 1);
+        case '}':  return token(TokenType::close_brace, 0, 1);
+        case '(':  return token(TokenType::open_paren, 0, 1);
+        case ')':  return token(TokenType::close_paren, 0, 1);
+        case '[':  return token(TokenType::open_bracket, 0, 1);
+        case ']':  return token(TokenType::close_bracket, 0, 1);
+        case ':':  return token(TokenType::colon, 0, 1);
+        case ',':  return token(TokenType::comma, 0, 1);
+        case '&':  return token(TokenType::ampersand, 0, 1);
+        case '%':  return token(TokenType::percent, 0, 1);
+        case '`':  return token(TokenType::backtick, 0, 1);
+        case '*':  return token(TokenType::asterisk, 0, 1);
+        case '+':  return token(TokenType::plus, 0, 1);
+        case '/':  return token(TokenType::slash, 0, 1);
+        case '^':  return token(TokenType::caret, 0, 1);
+        case '|':  return token(TokenType::vertical_bar, 0, 1);
+    }
+
+    // Numbers may have single spaces between their digits after the first, which are left out
+    // when they're read
     if (is_digit()) {
-        std::string value;
-        value += current();
-        position++;
+        size_t end = ++cursor;
         while (is_digit()) {
-            value += current();
-            position++;
-            if (current() == ' ') position++;
+            cursor++;
+            end = cursor;
+            if (current() == ' ') cursor++;
         }
-        position--;
-        return { TokenType::numeric_literal, value };
+        return token(TokenType::numeric_literal, end - start);
     }
 
     if (is_char()) {
-        std::string id;
-        while (is_char() || is_digit()) {
-            id += current();
-            position++;
-            if (position >= source_code.size()) break;
-        }
-        if (current() == '~') return { TokenType::object, id };
-        position--;
-        return { TokenType::identifier, id };
+        while (is_char() || is_digit()) cursor++;
+        const bool object = current() == '~';
+        const Token word = token(object ? TokenType::object : TokenType::identifier, cursor - start);
+        if (object) cursor++;
+        return word;
     }
 
     if (current() == '"') {
-        std::string string;
-        position++;
+        cursor++;
         while (current() != '"') {
-
-            if (current() == '\\') {
-                position++;
-                if (current() == 'n') string += '\n';
-                else position--;
+            if (current() == EOF) error("Program ended with unterminated string literal");
+            if (current() == '\n') {
+                line++;
+                line_start = cursor + 1;
             }
-
-            else string += current();
-            position++;
+            cursor++;
         }
-        return { TokenType::string_literal, string };
+        const Token string = token(TokenType::string_literal, cursor - start - 1, 1);
+        cursor++;
+        return string;
     }
 
-    if (current() == EOF || current() == -1) return { TokenType::eof, "" };
-    error("Unrecognised Token: " + std::string(1, current()));
-    return { TokenType::invalid, "" };
+    error("Unrecognised Token: " + std::string(1, (char) current()));
+    return token(TokenType::invalid);
 }
 
 int Lexer::current() const
 {
-    if (position >= source_code.size()) return EOF;
-    return source_code.at(position);
+    if (cursor >= source_code.size()) return EOF;
+    return (unsigned char) source_code[cursor];
 }
 
 bool Lexer::is_digit() const
@@ -153,635 +142,515 @@ bool Lexer::is_char() const
         ||  current() == '_';
 }
 
-bool Lexer::peek(const TokenType expected)
+void Lexer::lex()
 {
-    const size_t old_position = position;
-    const size_t old_lines = line;
-    bool ret;
-    if (get_next_token().type == expected) ret = true;
-    else ret = false;
-    position = old_position;
-    line = old_lines;
-    return ret;
+    tokens.clear();
+    tokens.reserve(source_code.size() / 2);
+    cursor = 0;
+    line = 1;
+    line_start = 0;
+
+    do tokens.push_back(lex_token());
+    while (tokens.back().type != TokenType::eof);
+
+    position = (size_t) -1;
+    line = 1;
 }
 
-bool Lexer::peek_expression()
+const Token& Lexer::get_next_token()
 {
-    return peek(TokenType::numeric_literal) || peek(TokenType::minus)
-        || peek(TokenType::string_literal)  || peek(TokenType::open_brace)
-        || peek(TokenType::open_paren)      || peek(TokenType::identifier)
-        || peek(TokenType::vertical_bar)    || peek(TokenType::backtick);
+    if (position + 1 < tokens.size()) position++;
+    line = tokens[position].line;
+    return tokens[position];
 }
 
-bool Lexer::peek_connection()
+TokenType Lexer::next_type() const
 {
-    return peek(TokenType::vertical_bar)
-        || peek(TokenType::arrow)
-        || peek(TokenType::newline)
-        || peek(TokenType::many_to_one)
-        || peek(TokenType::one_to_many)
-        || peek(TokenType::parallel)
-        || peek(TokenType::cross_connection)
-        || peek(TokenType::open_bracket);
+    return tokens[std::min(position + 1, tokens.size() - 1)].type;
 }
 
-Lexer::~Lexer() {}
+bool Lexer::peek(const TokenType expected) const
+{
+    return next_type() == expected;
+}
 
+bool Lexer::peek_expression() const
+{
+    switch (next_type()) {
+        case TokenType::numeric_literal:
+        case TokenType::minus:
+        case TokenType::string_literal:
+        case TokenType::open_brace:
+        case TokenType::open_paren:
+        case TokenType::identifier:
+        case TokenType::vertical_bar:
+        case TokenType::backtick:
+            return true;
+
+        default:
+            return false;
+    }
+}
 
+bool Lexer::peek_connection() const
+{
+    switch (next_type()) {
+        case TokenType::vertical_bar:
+        case TokenType::arrow:
+        case TokenType::newline:
+        case TokenType::many_to_one:
+        case TokenType::one_to_many:
+        case TokenType::parallel:
+        case TokenType::cross_connection:
+        case TokenType::open_bracket:
+            return true;
 
+        default:
+            return false;
+    }
+}
 
-using ObjectMap = std::map<std::string, void(Program::*)(const std::string&, const ArgumentList&)>;
-#define OBJECT(x) &Program::create_object<x>
-static const ObjectMap object_creators =
-{
-    // Signal generation
-    { "Sine_Oscillator",     OBJECT(OscillatorObject) },
-    { "Saw_Oscillator",      OBJECT(SawObject) },
-    { "Square_Oscillator",   OBJECT(SquareObject) },
-    { "Triangle_Oscillator", OBJECT(TriangleObject) },
-    { "Noise",               OBJECT(NoiseObject) },
-    { "Constant",            OBJECT(ConstObject) },
-    { "Clock",               OBJECT(ClockObject) },
-    { "Timer",               OBJECT(TimerObject) },
-    { "Phasor",              OBJECT(PhasorObject) },
-
-    // Arithmetic
-    { "Add",                 OBJECT(AddObject) },
-    { "Multiply",            OBJECT(MultObject) },
-    { "Subtract",            OBJECT(SubtractionObject) },
-    { "Divide",              OBJECT(DivisionObject) },
-    { "Power",               OBJECT(PowerObject) },
-    { "Exponentiate",        OBJECT(ExponentialObject) },
-
-    // Signal processing
-    { "Delay_Line",          OBJECT(DelayObject) },
-    { "Sample_And_Hold",     OBJECT(SampleAndHoldObject) },
-    { "Envelope_Follower",   OBJECT(EnvelopeFollowerObject) },
-    { "Envelope_Generator",  OBJECT(EnvelopeObject) },
-    { "Clamp",               OBJECT(ClampObject) },
-    { "Inverse",             OBJECT(InverseObject) },
-    { "Comparator",          OBJECT(ComparatorObject) },
-    { "Reciprocal",          OBJECT(ReciprocalObject) },
-    { "Bi_to_Unipolar",      OBJECT(BiToUnipolarObject) },
-    { "Invoke",              OBJECT(InvokeBlockwiseObject) },
-
-    // Maths functions
-    { "Sin",                 OBJECT(SinObject) },
-    { "Cos",                 OBJECT(CosObject) },
-    { "Tanh",                OBJECT(DriveObject) },
-    { "Modulo",              OBJECT(ModuloObject) },
-    { "Abs",                 OBJECT(AbsoluteValueObject) },
-    { "Floor",               OBJECT(RoundObject) },
-    { "Ceil",                OBJECT(CeilObject) },
-    { "Sign",                OBJECT(SignObject) },
-    { "Log",                 OBJECT(LogarithmObject) },
-    { "Atan",                OBJECT(AtanObject) },
-
-    // Sequences
-    { "Write_File",          OBJECT(FileoutObject) },
-    { "Read_File",           OBJECT(FileinObject) },
-    { "Step_Sequence",       OBJECT(StepSequence) },
-    { "Index_Sequence",      OBJECT(SequenceObject) },
-
-    // Frequency filters and frequency filter design
-    { "Smooth",              OBJECT(FilterObject) },
-    { "Lowpass_Filter",      OBJECT(LowpassObject) },
-    { "Highpass_Filter",     OBJECT(HighpassObject) },
-    { "Bandpass_Filter",     OBJECT(BandpassObject) },
-    { "Allpass_Filter",      OBJECT(AllpassObject) },
-    { "Convolver",           OBJECT(ConvolveObject) },
-    { "Pole",                OBJECT(PoleObject) },
-    { "Zero",                OBJECT(ZeroObject) },
-};
-#undef OBJECT
+Lexer::~Lexer() {}
 
 
-static void try_add_symbol(const std::string& name, const TypedValue& value, Graph* const program)
+
+
+// Numbers are read without the spaces between their digits
+static std::string digits_of(const Token& token)
+{
+    std::string digits(token.value);
+    digits.erase(std::remove(digits.begin(), digits.end(), ' '), digits.end());
+    return digits;
+}
+
+// Strings can have line breaks written `\n`. Backslashes before anything else are left out.
+static std::string unescape(const std::string_view text)
 {
-    if (program->symbol_exists(name)) return;
-    program->add_symbol(name, value);
+    std::string string;
+    for (size_t n = 0; n < text.size(); n++) {
+        if (text[n] != '\\') string += text[n];
+        else if (n + 1 < text.size() && text[n + 1] == 'n') {
+            string += '\n';
+            n++;
+        }
+    }
+    return string;
 }
 
+// Operators that declare an object where they're written in a connection, such as `-> * 2`
+static const std::map<TokenType, std::string> inline_operations =
+{
+    { TokenType::plus,     "Add" },
+    { TokenType::minus,    "Subtract" },
+    { TokenType::asterisk, "Multiply" },
+    { TokenType::slash,    "Divide" },
+    { TokenType::caret,    "Power" },
+    { TokenType::elipsis,  "Delay_Line" },
+};
+
 bool Parser::parse_program(Graph& graph)
 {
-    program = &graph;
-    try_add_symbol("sample_rate", get_sample_rate(), program);
-    try_add_symbol("fs", get_sample_rate(), program);
-    try_add_symbol("tau", TAU, program);
-    try_add_symbol("pi", TAU / 2.f, program);
-    try_add_symbol("true", 1, program);
-    try_add_symbol("false", 0, program);
-    try_add_symbol("i", Number(0, 1), program);
-    try_add_symbol("e", 2.718281828459045f, program);
-    try_add_symbol("blocksize", AudioBuffer::blocksize, program);
+    if (!syntax_tree || source_code != parsed_source) {
+        try {
+            lex();
+            syntax_tree = std::make_shared<const Block>(parse_block(false));
+            parsed_source = source_code;
+        } catch (const VolsungException&) {
+            syntax_tree.reset();
+            graph.reset();
+            return false;
+        }
+    }
 
-    try {
+    Evaluator evaluator;
+    evaluator.set_hook(parse_hook);
+    return evaluator.run(graph, syntax_tree);
+}
+
+Block Parser::parse_block(const bool braced)
+{
+    Block block;
 
     while (true) {
         while (peek(TokenType::newline)) next_token();
+        if (peek(TokenType::eof) || (braced && peek(TokenType::close_brace))) break;
+        block.push_back(parse_statement());
+    }
 
-        if (peek(TokenType::eof) || (program->parent && peek(TokenType::close_brace))) break;
-
-        if (peek(TokenType::identifier)) {
-            next_token();
-            if (peek(TokenType::colon)) parse_declaration();
-            else if (peek_connection()) parse_connection();
-            else if (peek(TokenType::open_paren) || peek(TokenType::dot)) {
-                parse_expression();
-            /* const std::string id = current_token.value;
-                parse_procedure_call(id);
-                next_token(); */
-                if (!(peek(TokenType::newline) || peek(TokenType::eof))) error ("Expected newline after expression");
-            }
-            else if (peek(TokenType::less_than)) parse_subgraph_declaration();
-            else {
-                next_token();
-                error("Expected operator or colon, got " + debug_names.at(current_token.type));
-            }
-        }
+    return block;
+}
 
-        else if (peek_expression()) {
-            next_token();
-            parse_expression();
+Statement Parser::parse_statement()
+{
+    if (peek(TokenType::identifier)) {
+        next_token();
+        if (peek(TokenType::colon)) return parse_declaration();
+        if (peek_connection()) return parse_connection(parse_object_reference());
+        if (peek(TokenType::less_than)) return parse_subgraph_declaration();
+
+        if (peek(TokenType::open_paren) || peek(TokenType::dot)) {
+            Statement statement = make_statement(Statement::Kind::expression);
+            statement.expressions.push_back(parse_expression());
+            if (!(peek(TokenType::newline) || peek(TokenType::eof))) error ("Expected newline after expression");
+            return statement;
         }
 
-        else if (peek(TokenType::object) || peek(TokenType::open_bracket)) {
-            next_token();
-            parse_connection();
-        }
+        next_token();
+        error("Expected operator or colon, got " + debug_names.at(current_token.type));
+    }
 
-        else if (peek(TokenType::ampersand)) parse_directive();
-        else {
-            next_token();
-            error("Expected declaration or connection, got " + debug_names.at(current_token.type));
-        }
-        if (parse_hook) parse_hook();
+    else if (peek_expression()) {
+        next_token();
+        Statement statement = make_statement(Statement::Kind::expression);
+        statement.expressions.push_back(parse_expression());
+        return statement;
     }
 
-    } catch (const VolsungException&) {
-        program->reset();
-        return false;
+    else if (peek(TokenType::object) || peek(TokenType::open_bracket)) {
+        next_token();
+        return parse_connection(parse_object_reference());
     }
-    return true;
+
+    else if (peek(TokenType::ampersand)) return parse_directive();
+
+    next_token();
+    error("Expected declaration or connection, got " + debug_names.at(current_token.type));
+    return { };
+}
+
+Statement Parser::make_statement(const Statement::Kind kind) const
+{
+    Statement statement;
+    statement.kind = kind;
+    statement.line = line;
+    return statement;
 }
 
-void Parser::parse_declaration()
+std::unique_ptr<Expression> Parser::make_expression(const Expression::Kind kind) const
 {
-    const std::string name = current_token.value;
+    auto expression = std::make_unique<Expression>();
+    expression->kind = kind;
+    expression->line = line;
+    return expression;
+}
+
+Statement Parser::parse_declaration()
+{
+    const std::string name(current_token.value);
     expect(TokenType::colon);
 
     if (peek_expression()) {
+        Statement statement = make_statement(Statement::Kind::symbol_declaration);
+        statement.name = name;
+        statement.symbol = intern(name);
         next_token();
-        const TypedValue value = parse_expression();
-        program->add_symbol(name, value);
+        statement.expressions.push_back(parse_expression());
+        return statement;
     }
 
     else if (peek(TokenType::object) || peek(TokenType::open_bracket)) {
         next_token();
-        parse_connection(parse_object_declaration(name));
+        const Symbol symbol = intern(name);
+        ObjectReference object = { line, symbol, parse_object_declaration(symbol), nullptr };
+        return parse_connection(std::move(object));
     }
 
-    else {
-        next_token();
-        error("Expected object, group, or expression, got " + debug_names.at(current_token.type));
-    }
+    next_token();
+    error("Expected object, group, or expression, got " + debug_names.at(current_token.type));
+    return { };
 }
 
-std::string Parser::parse_object_declaration(std::string name)
+std::unique_ptr<ObjectDeclaration> Parser::parse_object_declaration(const Symbol name)
 {
-    if (name.empty()) name = "Unnamed Object " + std::to_string(inline_object_index++);
-    bool is_group = false;
-    size_t count = 1;
+    auto declaration = std::make_unique<ObjectDeclaration>();
+    declaration->line = line;
+    declaration->name = name;
 
     if (current_token_is(TokenType::open_bracket)) {
-        is_group = true;
         next_token();
-        count = (int) parse_expression().get_value<Number>();
+        declaration->count = parse_expression();
         expect(TokenType::close_bracket);
         next_token();
     }
 
     verify(TokenType::object);
-    const std::string object_type = current_token.value;
-
-    if (is_group) {
-        const size_t old_position = position;
-
-        bool n_existed = false;
-        TypedValue old_n;
-        if (program->symbol_exists("n")) {
-            old_n = program->get_symbol_value("n");
-            n_existed = true;
-        }
-
-        for (size_t n = 0; n < count; n++) {
-            position = old_position;
-
-            program->remove_symbol("n");
-            program->add_symbol("n", n+1);
-
-            ArgumentList arguments = { };
-            if (peek_expression()) {
-                next_token();
-                arguments.push_back(parse_expression());
-            }
-
-            while (peek(TokenType::comma)) {
-                expect(TokenType::comma);
-                next_token();
-                arguments.push_back(parse_expression());
-            }
-
-            make_object(object_type, "__grp_" + name + std::to_string(n), arguments);
-            program->remove_symbol("n");
-        }
-        program->group_sizes.insert({ name, count });
+    declaration->type = current_token.value;
 
-        if (n_existed) program->add_symbol("n", old_n);
-    }
-
-    else {
-        if (program->group_sizes.count(name)) error("Object " + name + " already exists as group");
-        ArgumentList arguments = { };
-        if (peek_expression()) {
-            next_token();
-            arguments.push_back(parse_expression());
-        }
-
-        while (peek(TokenType::comma)) {
-            expect(TokenType::comma);
-            next_token();
-            arguments.push_back(parse_expression());
-        }
-
-        make_object(object_type, name, arguments);
+    if (peek_expression()) {
+        next_token();
+        declaration->arguments.push_back(parse_expression());
     }
 
-    return name;
-}
-
-void Parser::make_object(const std::string& object_type, const std::string& object_name, const ArgumentList& arguments)
-{
-    if (object_creators.count(object_type)) {
-        (program->*(object_creators.at(object_type)))(object_name, arguments);
-        return;
+    while (peek(TokenType::comma)) {
+        expect(TokenType::comma);
+        next_token();
+        declaration->arguments.push_back(parse_expression());
     }
 
-    SubgraphRepresentation subgraph = program->find_subgraph_recursively(object_type);
-
-    auto io = subgraph.second;
-    ArgumentList parameters = arguments;
-    parameters.insert(parameters.begin(), TypedValue { (Number) io[0] });
-    parameters.insert(parameters.begin() + 1, TypedValue { (Number) io[1] });
-
-    program->create_object<SubgraphObject>(object_name, parameters);
-
-    program->get_audio_object_raw_pointer<SubgraphObject>(object_name)->graph = std::make_unique<Program>();
-    Program* const other_program = program->get_audio_object_raw_pointer<SubgraphObject>(object_name)->graph.get();
-
-    Parser subgraph_parser;
-    subgraph_parser.source_code = subgraph.first;
-    other_program->parent = program;
-    other_program->configure_io((uint) io[0], (uint) io[1]);
-    other_program->reset();
-
-    for (size_t n = 2; n < parameters.size(); n++)
-        other_program->add_symbol("_" + std::to_string(n-1), parameters[n]);
-
-    if (!subgraph_parser.parse_program(*other_program)) error("Subgraph failed to parse");
-}
-
-void Parser::parse_connection()
-{
-    std::string output_object = get_object_to_connect();
-    parse_connection(output_object);
+    return declaration;
 }
 
-void Parser::parse_connection(std::string output_object)
+Statement Parser::parse_connection(ObjectReference object)
 {
-    int output_index = 0, input_index = 0;
-    std::string input_object;
-
-    if (peek(TokenType::vertical_bar)) {
-        expect(TokenType::vertical_bar);
-        expect(TokenType::numeric_literal);
-        output_index = std::stoi(current_token.value);
-    }
-    else (output_index = 0);
+    Statement statement = make_statement(Statement::Kind::connection);
+    statement.object = std::move(object);
+    statement.output = parse_output_index();
 
     while (peek(TokenType::newline)) {
         next_token();
     }
 
-    ConnectionType connection_type;
     bool got_newline = false;
-    int path_length = 0;
 
     while (peek(TokenType::arrow) || peek(TokenType::many_to_one) || peek(TokenType::one_to_many) || peek(TokenType::parallel) || peek(TokenType::cross_connection)) {
         next_token();
+        Connection connection;
 
         switch (current_token.type) {
-            case TokenType::arrow:            connection_type = ConnectionType::one_to_one; break;
-            case TokenType::many_to_one:      connection_type = ConnectionType::many_to_one; break;
-            case TokenType::one_to_many:      connection_type = ConnectionType::one_to_many; break;
-            case TokenType::parallel:         connection_type = ConnectionType::many_to_many; break;
-            case TokenType::cross_connection: connection_type = ConnectionType::biclique; break;
+            case TokenType::arrow:            connection.type = ConnectionType::one_to_one; break;
+            case TokenType::many_to_one:      connection.type = ConnectionType::many_to_one; break;
+            case TokenType::one_to_many:      connection.type = ConnectionType::one_to_many; break;
+            case TokenType::parallel:         connection.type = ConnectionType::many_to_many; break;
+            case TokenType::cross_connection: connection.type = ConnectionType::biclique; break;
             default: error("Expected connection operator, got " + debug_names.at(current_token.type));
         }
 
-        const bool series_modifier = peek(TokenType::series);
-        if (series_modifier) expect(TokenType::series);
+        connection.series = peek(TokenType::series);
+        if (connection.series) expect(TokenType::series);
 
         if (peek(TokenType::numeric_literal)) {
             expect(TokenType::numeric_literal);
-            input_index = std::stoi(current_token.value);
+            connection.input = std::stoi(digits_of(current_token));
             expect(TokenType::vertical_bar);
         }
-        else input_index = 0;
+        else connection.input = 0;
 
         next_token();
-        input_object = get_object_to_connect();
-
-        if (series_modifier) {
-            program->connect_objects(output_object, output_index, "__grp_" + input_object + "0", input_index, connection_type);
-            program->connect_objects(output_object, output_index, input_object, input_index, ConnectionType::series);
-            output_object = "__grp_" + input_object + std::to_string(program->group_sizes[input_object] - 1);
-        }
-
-        else {
-            program->connect_objects(output_object, output_index, input_object, input_index, connection_type);
-            output_object = input_object;
-        }
-
-        if (peek(TokenType::vertical_bar)) {
-            expect(TokenType::vertical_bar);
-            expect(TokenType::numeric_literal);
-            output_index = std::stoi(current_token.value);
-        }
-        else output_index = 0;
+        connection.target = parse_object_reference();
+        connection.output = parse_output_index();
+        statement.connections.push_back(std::move(connection));
 
         got_newline = false;
         while (peek(TokenType::newline)) { next_token(); got_newline = true; }
-        path_length++;
     };
 
-    if (!got_newline && path_length > 1) {
+    if (!got_newline && statement.connections.size() > 1) {
         next_token();
         Volsung::assert(line_end(), "Expected newline or connection operator, got " + debug_names.at(current_token.type));
     }
+
+    return statement;
 }
 
-std::string Parser::get_object_to_connect()
+int Parser::parse_output_index()
 {
-    std::string output;
+    if (!peek(TokenType::vertical_bar)) return 0;
+    expect(TokenType::vertical_bar);
+    expect(TokenType::numeric_literal);
+    return std::stoi(digits_of(current_token));
+}
 
-    if (current_token_is(TokenType::plus)
-     || current_token_is(TokenType::minus)
-     || current_token_is(TokenType::asterisk)
-     || current_token_is(TokenType::slash)
-     || current_token_is(TokenType::elipsis)
-     || current_token_is(TokenType::caret)) {
+ObjectReference Parser::parse_object_reference()
+{
+    ObjectReference object = { line, unnamed, nullptr, nullptr };
 
-        const Token operation = current_token;
+    if (inline_operations.count(current_token.type)) {
+        object.declaration = std::make_unique<ObjectDeclaration>();
+        object.declaration->line = line;
+        object.declaration->type = inline_operations.at(current_token.type);
         next_token();
-        const ArgumentList argument = { parse_expression() };
-
-        output = "Unnamed Object " + std::to_string(inline_object_index++);
-
-        if (operation.type != TokenType::object) {
-            switch (operation.type) {
-                case (TokenType::plus):     program->create_object<AddObject>(output, argument); break;
-                case (TokenType::minus):    program->create_object<SubtractionObject>(output, argument); break;
-                case (TokenType::asterisk): program->create_object<MultObject>(output, argument); break;
-                case (TokenType::slash):    program->create_object<DivisionObject>(output, argument); break;
-                case (TokenType::caret):    program->create_object<PowerObject>(output, argument); break;
-                case (TokenType::elipsis):  program->create_object<DelayObject>(output, argument); break;
-                default: error("Invalid token for inline operation: " + debug_names.at(operation.type) + ". Expected arithmetic operator");
-            }
-        } else {
-            make_object(operation.value, output, argument);
-        }
+        object.declaration->arguments.push_back(parse_expression());
     }
 
     else if (current_token_is(TokenType::identifier)) {
-        output = current_token.value;
+        object.name = intern(current_token.value);
 
         if (peek(TokenType::colon)) {
             next_token();
             next_token();
-            parse_object_declaration(output);
+            object.declaration = parse_object_declaration(object.name);
         }
-        Volsung::assert(program->object_exists(output), "Undefined object: " + output);
 
         if (peek(TokenType::open_bracket)) {
             expect(TokenType::open_bracket);
             next_token();
-            const int index = (int) parse_number();
+            object.index = parse_number();
             expect(TokenType::close_bracket);
-            output = "__grp_" + output + std::to_string(index);
         }
     }
 
     else if (current_token_is(TokenType::object) || current_token_is(TokenType::open_bracket)) {
-            output = parse_object_declaration();
+        object.declaration = parse_object_declaration();
     }
 
     else {
         error("Expected inline object declaration or identifier, got " + debug_names.at(current_token.type));
     }
 
-    return output;
+    return object;
 }
 
-void Parser::parse_directive()
+Statement Parser::parse_directive()
 {
     expect(TokenType::ampersand);
     expect(TokenType::identifier);
-    const std::string directive = current_token.value;
-    ArgumentList arguments;
+    Statement statement = make_statement(Statement::Kind::directive);
+    statement.name = current_token.value;
 
     if (!peek(TokenType::newline)) {
         next_token();
-        arguments.push_back(parse_expression());
+        statement.expressions.push_back(parse_expression());
 
         while (peek(TokenType::comma)) {
             expect(TokenType::comma);
             next_token();
-            arguments.push_back(parse_expression());
+            statement.expressions.push_back(parse_expression());
         }
     }
-    program->invoke_directive(directive, arguments);
+    return statement;
 }
 
-void Parser::parse_subgraph_declaration()
+Statement Parser::parse_subgraph_declaration()
 {
-    const std::string name = current_token.value;
+    Statement statement = make_statement(Statement::Kind::subgraph_declaration);
+    statement.name = current_token.value;
+    statement.symbol = intern(statement.name);
 
     expect(TokenType::less_than);
     next_token();
-    const float inputs = parse_expression().get_value<Number>();
+    statement.expressions.push_back(parse_expression());
     expect(TokenType::comma);
     next_token();
-    const float outputs = parse_expression().get_value<Number>();
+    statement.expressions.push_back(parse_expression());
     expect(TokenType::greater_than);
     expect(TokenType::colon);
     expect(TokenType::open_brace);
     expect(TokenType::newline);
 
-    const size_t start_position = position;
-    int num_braces_encountered = 0;
-
-    while (true) {
-        position++;
-        if (current() == '}') {
-            if (!num_braces_encountered) break;
-            num_braces_encountered--;
-        }
-        if (current() == '\n') line++;
-        if (current() == EOF || current() == -1) error("Program ended with incomplete subgraph definition");
-        if (current() == '{') num_braces_encountered++;
-    }
-
-    position--;
-    program->subgraphs.insert({ name, { source_code.substr(start_position, position - start_position), { inputs, outputs } } });
+    const size_t start = current_token.offset;
+    statement.body = parse_block(true);
+    if (peek(TokenType::eof)) error("Program ended with incomplete subgraph definition");
     expect(TokenType::close_brace);
+
+    statement.text = source_code.substr(start, current_token.offset - start);
+    return statement;
 }
 
-TypedValue Parser::parse_expression()
+std::unique_ptr<Expression> Parser::parse_expression()
 {
-    TypedValue value = parse_sequence_generator();
+    auto value = parse_sequence_generator();
     while (peek(TokenType::plus) || peek(TokenType::minus)) {
         next_token();
-        const bool subtract = current_token_is(TokenType::minus);
+        auto operation = make_expression(current_token_is(TokenType::minus) ? Expression::Kind::subtract : Expression::Kind::add);
         next_token();
-        const TypedValue operand = parse_sequence_generator();
-
-        if (subtract) value -= operand;
-        else value += operand;
+        operation->operands.push_back(std::move(value));
+        operation->operands.push_back(parse_sequence_generator());
+        value = std::move(operation);
     }
     return value;
 }
 
-TypedValue Parser::parse_sequence_generator()
+std::unique_ptr<Expression> Parser::parse_sequence_generator()
 {
-    TypedValue value = parse_product();
+    auto value = parse_product();
     if (peek(TokenType::elipsis)) {
         expect(TokenType::elipsis);
         next_token();
 
-        const float lower = value.get_value<Number>();
-        const float upper = parse_product().get_value<Number>();
+        auto range = make_expression(Expression::Kind::range);
+        range->operands.push_back(std::move(value));
+        range->operands.push_back(parse_product());
 
         if (peek(TokenType::elipsis)) {
             next_token();
             next_token();
-            const float target = parse_product().get_value<Number>();
-            const float step_size = (target - lower) / (upper - 1);
-            Sequence s;
-            for (size_t n = 0; n < upper; n++)
-                s.add_element(lower + n * step_size);
-            value = s;
+            range->kind = Expression::Kind::interpolated_range;
+            range->operands.push_back(parse_product());
         }
 
-        else {
-            float step = 1;
-            if (peek(TokenType::vertical_bar)) {
-                next_token();
-                next_token();
-                step = parse_product().get_value<Number>();
-            }
-
-            Sequence s;
-            if (lower > upper) for (float n = lower; n >= upper; n -= step) s.add_element(n);
-            else               for (float n = lower; n <= upper; n += step) s.add_element(n);
-            value = s;
+        else if (peek(TokenType::vertical_bar)) {
+            next_token();
+            next_token();
+            range->operands.push_back(parse_product());
         }
+
+        value = std::move(range);
     }
     return value;
 }
 
-TypedValue Parser::parse_product()
+std::unique_ptr<Expression> Parser::parse_product()
 {
-    TypedValue value = parse_power();
+    auto value = parse_power();
     while (peek(TokenType::asterisk) || peek(TokenType::slash)) {
         next_token();
-        const bool divide = current_token_is(TokenType::slash);
+        auto operation = make_expression(current_token_is(TokenType::slash) ? Expression::Kind::divide : Expression::Kind::multiply);
         next_token();
-        const TypedValue operand = parse_power();
-
-        if (divide) value /= operand;
-        else value *= operand;
+        operation->operands.push_back(std::move(value));
+        operation->operands.push_back(parse_power());
+        value = std::move(operation);
     }
     return value;
 }
 
-TypedValue Parser::parse_power()
+std::unique_ptr<Expression> Parser::parse_power()
 {
-    TypedValue value = parse_unary_postfix();
+    auto value = parse_unary_postfix();
     if (peek(TokenType::caret)) {
         expect(TokenType::caret);
         next_token();
-        const TypedValue operand = parse_power();
 
-        value ^= operand;
+        auto operation = make_expression(Expression::Kind::power);
+        operation->operands.push_back(std::move(value));
+        operation->operands.push_back(parse_power());
+        value = std::move(operation);
     }
     return value;
 }
 
-TypedValue Parser::parse_unary_postfix()
+std::unique_ptr<Expression> Parser::parse_unary_postfix()
 {
-    TypedValue value = parse_factor();
+    auto value = parse_factor();
     while (peek(TokenType::open_bracket) || peek(TokenType::dot) || peek(TokenType::open_paren)) {
         if (peek(TokenType::open_bracket)) {
             expect(TokenType::open_bracket);
-            if (!value.is_type<Sequence>()) error("Attempted to subscript non-sequence");
+            auto subscript = make_expression(Expression::Kind::subscript);
             next_token();
 
-            const TypedValue index = parse_expression();
+            subscript->operands.push_back(std::move(value));
+            subscript->operands.push_back(parse_expression());
             expect(TokenType::close_bracket);
-
-            if (index.is_type<Number>()) {
-                value = value.get_value<Sequence>()[(int) index.get_value<Number>()];
-            }
-
-            else if (index.is_type<Sequence>()) {
-                Sequence s;
-                const Sequence& index_sequence = index.get_value<Sequence>();
-                const Sequence& value_sequence = value.get_value<Sequence>();
-
-                for (size_t n = 0; n < index_sequence.size(); n++)
-                    s.add_element(value_sequence[(size_t) index_sequence[(size_t) n]]);
-
-                value = s;
-            }
-
-            else error("Index into sequence must be a number or a sequence");
+            value = std::move(subscript);
         }
         else if (peek(TokenType::open_paren)) {
-            if (!value.is_type<Procedure>()) error("Attempted to call non-procedure. Value is: " + value.as_string());
-            value = parse_procedure_call(value);
+            value = parse_procedure_call(std::move(value));
         }
         else {
             expect(TokenType::dot);
             next_token();
-            TypedValue param = value;
+            auto object = std::move(value);
             value = parse_identifier();
-            value = parse_procedure_call(value, param, true);
+            value = parse_procedure_call(std::move(value), std::move(object));
         }
     }
     return value;
 }
 
-TypedValue Parser::parse_factor()
+std::unique_ptr<Expression> Parser::parse_factor()
 {
-    TypedValue value = 0;
+    std::unique_ptr<Expression> value;
 
     switch (current_token.type) {
         case TokenType::backtick:
         case TokenType::identifier      :  value = parse_identifier();  break;
         case TokenType::numeric_literal :  value = parse_number();      break;
-        case TokenType::string_literal  :  value = current_token.value; break;
-        case TokenType::open_brace      :  value = parse_sequence(); break;
+        case TokenType::open_brace      :  value = parse_sequence();    break;
+        case TokenType::vertical_bar    :  value = parse_function();    break;
+
+        case TokenType::string_literal:
+            value = make_expression(Expression::Kind::literal);
+            value->value = unescape(current_token.value);
+            break;
 
         case TokenType::open_paren:
             next_token();
@@ -790,81 +659,55 @@ TypedValue Parser::parse_factor()
             break;
 
         case TokenType::minus:
+            value = make_expression(Expression::Kind::negate);
             next_token();
-            value = -parse_product();
+            value->operands.push_back(parse_product());
             break;
 
-        case TokenType::vertical_bar: {
-            std::vector<std::string> ids;
-
-            if (peek(TokenType::identifier)) while (true) {
-                expect(TokenType::identifier);
-                ids.push_back(current_token.value);
-                if (peek(TokenType::comma)) next_token();
-                else break;
-            }
-
-            expect(TokenType::vertical_bar);
-            if (peek(TokenType::newline)) next_token();
-            expect(TokenType::open_brace);
-            if (peek(TokenType::newline)) next_token();
-  
-            const size_t start_position = position + 1;
-            int num_braces_encountered = 0;
-
-            while (true) {
-                position++;
-                if (current() == '}') {
-                    if (!num_braces_encountered) break;
-                    num_braces_encountered--;
-                }
-                if (current() == '\n') line++;
-                if (current() == EOF || current() == -1) error("Program ended with incomplete function definition");
-                if (current() == '{') num_braces_encountered++;
-            }
-
-            const std::string expression_text = source_code.substr(start_position, position - start_position);
-            position--;
-
-            if (peek(TokenType::newline)) next_token();
-            expect(TokenType::close_brace);
-            Program* parent = program;
+        default: error("Couldn't get value of expression factor of token type " + debug_names.at(current_token.type));
+    }
 
-            Procedure::Implementation impl = [ids, expression_text, parent] (const ArgumentList& args, Program*) {
-                Program* program = new Program;
-                program->parent = parent;
+    return value;
+}
 
-                for (size_t n = 0; n < args.size() && n < ids.size(); n++)
-                    program->add_symbol(ids[n], args[n]);
+std::unique_ptr<Expression> Parser::parse_function()
+{
+    auto function = make_expression(Expression::Kind::function);
 
-                Parser parser;
-                parser.parse_program(*program);
-                parser.source_code = expression_text;
-                parser.next_token();
-                if (parser.current_token.type == TokenType::eof) return TypedValue(0);
-                return parser.parse_expression();
-            };
+    if (peek(TokenType::identifier)) while (true) {
+        expect(TokenType::identifier);
+        function->parameters.push_back(intern(current_token.value));
+        if (peek(TokenType::comma)) next_token();
+        else break;
+    }
 
-            value = Procedure(impl, ids.size(), ids.size(), false);
-            break;
-        }
+    expect(TokenType::vertical_bar);
+    if (peek(TokenType::newline)) next_token();
+    expect(TokenType::open_brace);
+    while (peek(TokenType::newline)) next_token();
 
-        default: error("Couldn't get value of expression factor of token type " + debug_names.at(current_token.type));
+    if (!peek(TokenType::close_brace)) {
+        next_token();
+        function->operands.push_back(parse_expression());
+        while (peek(TokenType::newline)) next_token();
     }
 
-    return value;
+    if (peek(TokenType::eof)) error("Program ended with incomplete function definition");
+    expect(TokenType::close_brace);
+    return function;
 }
 
-Number Parser::parse_number()
+std::unique_ptr<Expression> Parser::parse_number()
 {
     verify(TokenType::numeric_literal);
-    std::string number_string = current_token.value;
+    auto value = make_expression(Expression::Kind::literal);
+    std::string number_string = digits_of(current_token);
 
     if (peek(TokenType::dot)) {
         next_token();
         number_string += '.';
         expect(TokenType::numeric_literal);
-        number_string += current_token.value;
+        number_string += digits_of(current_token);
     }
 
     float number = std::stof(number_string);
@@ -872,8 +715,11 @@ Number Parser::parse_number()
     bool imaginary = false;
     if (peek(TokenType::identifier)) {
         next_token();
-        if (current_token.value == "s")        multiplier = get_sample_rate();
-        else if (current_token.value == "ms")  multiplier = get_sample_rate() / 1000;
+        if (current_token.value == "s")        value->kind = Expression::Kind::duration;
+        else if (current_token.value == "ms") {
+            value->kind = Expression::Kind::duration;
+            value->divisor = 1000;
+        }
         else if (current_token.value == "deg") multiplier = TAU / 360.0;
         else if (current_token.value == "i")   imaginary = true;
         else if (current_token.value == "dB"
@@ -885,76 +731,64 @@ Number Parser::parse_number()
         multiplier = 0.01;
     }
 
-    if (imaginary) return Number(0, number);
-    return number * multiplier;
+    if (imaginary) value->value = Number(0, number);
+    else value->value = Number(number * multiplier);
+    return value;
 }
 
-Sequence Parser::parse_sequence()
+std::unique_ptr<Expression> Parser::parse_sequence()
 {
-    Sequence s;
+    auto sequence = make_expression(Expression::Kind::sequence);
     next_token();
-    s.add_element(parse_expression().get_value<Number>());
+    sequence->operands.push_back(parse_expression());
 
     while (peek(TokenType::comma)) {
         expect(TokenType::comma);
         next_token();
-        s.add_element(parse_expression().get_value<Number>());
+        sequence->operands.push_back(parse_expression());
     }
 
     expect(TokenType::close_brace);
-    return s;
+    return sequence;
 }
 
-TypedValue Parser::parse_procedure_call(TypedValue value, TypedValue lhs, bool use_lhs)
+std::unique_ptr<Expression> Parser::parse_procedure_call(std::unique_ptr<Expression> procedure, std::unique_ptr<Expression> object)
 {
-    ArgumentList arguments;
-    const std::string name = current_token.value;
+    auto call = make_expression(object ? Expression::Kind::method_call : Expression::Kind::call);
+    call->name = current_token.value;
 
-    if (use_lhs) arguments.push_back(lhs);
+    if (object) call->operands.push_back(std::move(object));
+    call->operands.push_back(std::move(procedure));
 
     expect(TokenType::open_paren);
     if (peek_expression()) {
         next_token();
-        arguments.push_back(parse_expression());
+        call->operands.push_back(parse_expression());
 
         while (peek(TokenType::comma)) {
             expect(TokenType::comma);
             next_token();
-            arguments.push_back(parse_expression());
+            call->operands.push_back(parse_expression());
         }
     }
     expect(TokenType::close_paren);
-    Procedure procedure = value.get_value<Procedure>();
-
-    if (procedure.max_arguments < arguments.size())
-        Volsung::error("Too many arguments in procedure call to '" + name +"'. Expected " + std::to_string(procedure.max_arguments) +", got " + std::to_string(arguments.size()));
-
-    if (procedure.min_arguments > arguments.size())
-        Volsung::error("Too few arguments in procedure call to '" + name +"'. Expected " + std::to_string(procedure.min_arguments) +", got " + std::to_string(arguments.size()));
 
-    return procedure(arguments, program);
+    return call;
 }
 
-TypedValue Parser::parse_identifier()
+std::unique_ptr<Expression> Parser::parse_identifier()
 {
-    Program* old = program;
-    TypedValue value;
+    auto identifier = make_expression(Expression::Kind::identifier);
 
     while (current_token.type == TokenType::backtick) {
-        if (!program->parent) error("Attempted to use backtick in top-level program. Only use ` in a subgraph or a function definition");
-        program = program->parent;
+        identifier->parent_levels++;
         next_token();
     }
 
     verify(TokenType::identifier);
-    const std::string id = current_token.value;
-
-    if (program->symbol_exists(id)) value = program->get_symbol_value(id);
-    else if (Program::procedures.count(id)) value = Program::procedures.at(id);
-    else error("Symbol not found: " + id);
-
-    program = old;
-    return value;
+    identifier->name = current_token.value;
+    identifier->symbol = intern(current_token.value);
+    return identifier;
 }
 
 bool Parser::line_end() const
@@ -969,10 +803,10 @@ bool Parser::current_token_is(TokenType type) const
 
 void Parser::error(const std::string& error) const
 {
-    Volsung::error("Line " + std::to_string(line) + ": " + error);
+    Volsung::error("Line " + std::to_string(line) + ", column " + std::to_string(current_token.column) + ": " + error);
 }
 
-Token Parser::next_token()
+const Token& Parser::next_token()
 {
     current_token = get_next_token();
     return current_token;
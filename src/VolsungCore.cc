@@ -1,4 +1,7 @@
 
+#include <deque>
+#include <mutex>
+
 #include "VolsungCore.hh"
 
 namespace Volsung {
@@ -28,6 +31,47 @@ std::string get_library_path()
 }
 
 
+// Names are kept in a deque, which doesn't move them as it grows, so the keys can view them.
+// Programs can be built on more than one thread, which share the IDs.
+namespace {
+
+struct Interner
+{
+    std::mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, Symbol> ids;
+};
+
+Interner& interner()
+{
+    static Interner instance;
+    return instance;
+}
+
+}
+
+Symbol intern(const std::string_view name)
+{
+    Interner& table = interner();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    const auto found = table.ids.find(name);
+    if (found != table.ids.end()) return found->second;
+
+    const Symbol id = (Symbol) table.names.size();
+    table.names.emplace_back(name);
+    table.ids.emplace(table.names.back(), id);
+    return id;
+}
+
+const std::string& symbol_name(const Symbol id)
+{
+    Interner& table = interner();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.names.at(id);
+}
+
+
 static std::function<void(std::string)> debug_callback = [] (std::string message)
 {
     std::cout << message;
@@ -110,9 +110,9 @@ bypass|1 -> 1|output
     parser.parse_program(prog);
     log("Finished parsing");
 
-    const size_t num_blocks = time / AudioBuffer::blocksize;
+    const size_t num_blocks = time / prog.get_blocksize();
     if (print) for (uint n = 0; n < num_blocks; n++)
-        for (uint n = 0; n < AudioBuffer::blocksize; n++)
+        for (uint n = 0; n < prog.get_blocksize(); n++)
             std::cout << prog.run()[0][n] << '\n' << std::flush;
 
     else for (uint n = 0; n < num_blocks; n++) prog.run();
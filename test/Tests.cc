@@ -1,10 +1,20 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <tuple>
 
 #include "Volsung.hh"
+#include "FFT.hh"
+#include "Convolution.hh"
 
 using namespace Volsung;
 namespace chrono = std::chrono;
@@ -14,6 +24,513 @@ const std::string Ansi_Green   = "\033[32m";
 const std::string Ansi_Yellow  = "\033[33m";
 const std::string Ansi_Reset   = "\033[0m";
 
+#ifndef VOLSUNG_TEST_COMPILER
+#define VOLSUNG_TEST_COMPILER "c++"
+#endif
+
+// Programs covering the objects that can be exported, each run at a few block sizes
+const std::vector<std::pair<std::string, std::string>> exported_programs = {
+    { "Oscillators", R"(
+Saw_Oscillator~ 220 -> *0.3 -> output
+Square_Oscillator~ 331, 0.3 -> *0.3 -> output
+Triangle_Oscillator~ 97 -> *0.3 -> 1|output
+Sine_Oscillator~ 440, 1 -> *0.1 -> 1|output
+)" },
+    { "Modulated_Oscillators", R"(
+lfo: Sine_Oscillator~ 3
+lfo -> *200 -> +300 -> Saw_Oscillator~ -> *0.3 -> output
+lfo -> *100 -> +300 -> Square_Oscillator~ -> *0.3 -> output
+lfo -> 1|Square_Oscillator~ 120 -> *0.3 -> 1|output
+lfo -> *50 -> +200 -> Triangle_Oscillator~ -> *0.3 -> 1|output
+Clock~ 10ms -> 1|Saw_Oscillator~ 77 -> *0.2 -> 1|output
+)" },
+    { "Filters", R"(
+Noise~ -> Lowpass_Filter~ 1000, 0.7 -> output
+Noise~ -> Highpass_Filter~ 3000, 2 -> output
+Noise~ -> Bandpass_Filter~ 500, 4 -> 1|output
+Saw_Oscillator~ 100 -> Allpass_Filter~ 800, 1 -> Lowpass_Filter~ 200, 0 -> 1|output
+)" },
+    { "Delays", R"(
+Clock~ 5ms -> Delay_Line~ 100 -> output
+Noise~ -> Delay_Line~ 17.5 -> *0.5 -> output
+Sine_Oscillator~ 200 -> 0|modulated: Delay_Line~
+Sine_Oscillator~ 30 -> *100 -> +101.3 -> 1|modulated
+modulated -> 1|output
+)" },
+    { "Envelopes", R"(
+Clock~ 3ms -> Envelope_Generator~ 1ms -> output
+Clock~ 7ms -> Envelope_Generator~ 0 -> output
+Clock~ 2ms -> Envelope_Generator~ 1ms, 0.2, 0.9 -> Envelope_Follower~ 1ms, 2ms -> 1|output
+Noise~ -> Envelope_Follower~ 1ms, 3ms -> 1|output
+Sine_Oscillator~ 100 -> *300 -> +400 -> 1|Envelope_Follower~ -> 1|output
+)" },
+    { "Feedback_Loops", R"(
+a: Delay_Line~ 40.5
+b: Delay_Line~ 70
+Clock~ 5ms -> a
+a -> *100 -> +200 -> Saw_Oscillator~ -> b -> *0.3 -> a
+b -> *0.5 -> output
+
+comb: Delay_Line~ 300
+Clock~ 20ms -> Envelope_Generator~ 1ms -> 1|excitation: Multiply~
+Noise~ -> excitation -> comb
+comb -> Lowpass_Filter~ 3000, 0.7 -> *0.95 -> comb
+comb -> 1|output
+
+sum: Add~
+Noise~ -> sum -> Lowpass_Filter~ 800, 1 -> half: Multiply~ 0.5 -> 1|sum
+half -> 1|output
+)" },
+};
+
+static bool holds(const Sequence& sequence, const std::vector<float>& reals, std::string& message,
+                  const std::vector<float>& imags = { })
+{
+    bool same = sequence.size() == reals.size();
+    for (size_t n = 0; same && n < reals.size(); n++)
+        same = sequence.real_data()[n] == reals[n] && (imags.empty() || sequence.imag_data()[n] == imags[n]);
+
+    if (!same) message = "A sequence holds " + TypedValue(sequence).as_string() + ", which it shouldn't";
+    return same;
+}
+
+// Sequences share their elements when copied, so changing a copy mustn't change the original
+const std::vector<std::pair<std::string, std::function<bool(std::string&)>>> copy_on_write_checks = {
+    { "set", [] (std::string& message) {
+        const Sequence original({ 1, 2, 3 });
+        Sequence copy = original;
+        copy.set(0, 5);
+        return holds(original, { 1, 2, 3 }, message) && holds(copy, { 5, 2, 3 }, message);
+    } },
+    { "set_complex", [] (std::string& message) {
+        const Sequence original({ 1, 2 }, { 3, 4 });
+        Sequence copy = original;
+        copy.set(1, Number(5, 6));
+        return holds(original, { 1, 2 }, message, { 3, 4 }) && holds(copy, { 1, 5 }, message, { 3, 6 });
+    } },
+    { "real_data", [] (std::string& message) {
+        const Sequence original({ 1, 2, 3 });
+        Sequence copy = original;
+        copy.real_data()[2] = 5;
+        return holds(original, { 1, 2, 3 }, message) && holds(copy, { 1, 2, 5 }, message);
+    } },
+    { "add_element", [] (std::string& message) {
+        const Sequence original({ 1, 2, 3 });
+        Sequence copy = original;
+        copy.add_element(4);
+        return holds(original, { 1, 2, 3 }, message) && holds(copy, { 1, 2, 3, 4 }, message);
+    } },
+    { "negate", [] (std::string& message) {
+        const Sequence original({ 1, 2, 3 });
+        Sequence copy = original;
+        copy.negate();
+        return holds(original, { 1, 2, 3 }, message) && holds(copy, { -1, -2, -3 }, message);
+    } },
+    { "add_number", [] (std::string& message) {
+        const TypedValue original = Sequence({ 1, 2, 3 });
+        TypedValue copy = original;
+        copy += Number(1);
+        return holds(original.get_value<Sequence>(), { 1, 2, 3 }, message) && holds(copy.get_value<Sequence>(), { 2, 3, 4 }, message);
+    } },
+    { "add_itself", [] (std::string& message) {
+        const TypedValue original = Sequence({ 1, 2, 3 });
+        TypedValue copy = original;
+        copy += original;
+        return holds(original.get_value<Sequence>(), { 1, 2, 3 }, message) && holds(copy.get_value<Sequence>(), { 2, 4, 6 }, message);
+    } },
+    { "symbols", [] (std::string& message) {
+        Program program;
+        program.configure_io(0, 1);
+        program.reset();
+
+        Parser parser;
+        parser.source_code = "a: { 1, 4, 9 }\ncopied: a\nsum: a + 1\nnegated: -a\nroots: sqrt(a)\nsquared: a * a\n";
+        if (!parser.parse_program(program)) return false;
+
+        return holds(program.get_symbol_value<Sequence>("a"), { 1, 4, 9 }, message)
+            && holds(program.get_symbol_value<Sequence>("copied"), { 1, 4, 9 }, message)
+            && holds(program.get_symbol_value<Sequence>("sum"), { 2, 5, 10 }, message)
+            && holds(program.get_symbol_value<Sequence>("negated"), { -1, -4, -9 }, message)
+            && holds(program.get_symbol_value<Sequence>("roots"), { 1, 2, 3 }, message)
+            && holds(program.get_symbol_value<Sequence>("squared"), { 1, 16, 81 }, message);
+    } },
+};
+
+// Runs the program at the block size, giving back a channel of its output. Errors in the program
+// are reported through the debug callback.
+static bool render(const std::string& source, const size_t blocksize, const size_t length, std::vector<float>& samples,
+                   const size_t channel = 0)
+{
+    Program program;
+    program.set_blocksize(blocksize);
+    program.configure_io(0, 2);
+    program.reset();
+
+    Parser parser;
+    parser.source_code = source;
+    if (!parser.parse_program(program)) return false;
+
+    samples.clear();
+    while (samples.size() < length) {
+        const MultichannelBuffer output = program.run();
+        for (size_t n = 0; n < blocksize && samples.size() < length; n++) samples.push_back(output[channel][n]);
+    }
+    return true;
+}
+
+static bool same_samples(const std::vector<float>& actual, const std::vector<float>& expected, std::string& message)
+{
+    for (size_t n = 0; n < expected.size(); n++) {
+        if (std::memcmp(&actual[n], &expected[n], sizeof(float))) {
+            message = "Sample " + std::to_string(n) + " is " + std::to_string(actual[n]) + ", not " + std::to_string(expected[n]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Programs make the same output whatever their block size, feedback loops included. Each noise
+// object made is seeded differently, so noise is swapped for a saw wave.
+static bool output_ignores_blocksize(std::string source, const size_t blocksize, std::string& message)
+{
+    constexpr size_t length = 3 * AudioBuffer::max_blocksize;
+    for (size_t position; (position = source.find("Noise~")) != std::string::npos;)
+        source.replace(position, 6, "Saw_Oscillator~ 1234.5");
+
+    for (size_t channel = 0; channel < 2; channel++) {
+        std::vector<float> expected, samples;
+        if (!render(source, 1, length, expected, channel) || !render(source, blocksize, length, samples, channel)) return false;
+        if (!same_samples(samples, expected, message)) {
+            message = "Channel " + std::to_string(channel) + ": " + message;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rejects_blocksize(const size_t blocksize, std::string& message)
+{
+    const std::string expected = "Block size must be between 1 and " + std::to_string(AudioBuffer::max_blocksize) + "\n";
+    Program program;
+    try { program.set_blocksize(blocksize); }
+    catch (const VolsungException&) {
+        if (message == expected) {
+            message.clear();
+            return true;
+        }
+        message = "The error was \"" + message + "\"";
+        return false;
+    }
+    message = "The block size was accepted";
+    return false;
+}
+
+// Sends a click around a feedback loop through a delay, which should echo it exactly that many
+// samples later each time round, whatever the block size
+static bool echoes_land_on_time(const size_t delay, const size_t blocksize, std::string& message)
+{
+    const std::string source = "mix: Add~ 0\n"
+                               "Clock~ 1s -> mix -> output\n"
+                               "mix -> Delay_Line~ " + std::to_string(delay) + " -> Multiply~ 0.5 -> mix\n";
+
+    std::vector<float> samples;
+    if (!render(source, blocksize, 8 * delay, samples)) return false;
+
+    const size_t click = std::find_if(samples.begin(), samples.end(), [] (float sample) { return sample != 0; }) - samples.begin();
+    if (click >= delay) {
+        message = "The click wasn't heard before its first echo";
+        return false;
+    }
+
+    std::vector<float> expected(samples.size());
+    for (size_t n = 0; n < expected.size(); n++)
+        expected[n] = (n == click) + (n >= delay ? 0.5f * expected[n - delay] : 0.f);
+    return same_samples(samples, expected, message);
+}
+
+// The compiler runs constant objects once and leaves out objects nothing depends on. Neither may
+// change what the program does.
+const std::vector<std::pair<std::string, std::function<bool(std::string&)>>> simplification_checks = {
+    { "Constants", [] (std::string& message) {
+        std::vector<float> samples;
+        return render("Constant~ 3 -> *2 -> +1 -> output", 64, 256, samples)
+            && same_samples(samples, std::vector<float>(256, 7.f), message);
+    } },
+    { "Zero_Gain_On_Infinities", [] (std::string& message) {
+        std::vector<float> samples;
+        if (!render("Sine_Oscillator~ 100 -> Divide~ 0 -> Multiply~ 0 -> output", 64, 256, samples)) return false;
+
+        for (size_t n = 0; n < samples.size(); n++) {
+            if (!std::isnan(samples[n])) {
+                message = "Sample " + std::to_string(n) + " is " + std::to_string(samples[n]) + ", not NaN";
+                return false;
+            }
+        }
+        return true;
+    } },
+    { "File_Output_Branch", [] (std::string& message) {
+        constexpr size_t blocksize = 64, length = 1024;
+        const std::string filename = (std::filesystem::temp_directory_path() / "volsung_file_output_test").string();
+        std::filesystem::remove(filename);
+
+        Program program;
+        program.set_blocksize(blocksize);
+        program.configure_io(0, 2);
+        program.reset();
+
+        Parser parser;
+        parser.source_code = "Sine_Oscillator~ 200 -> output\n"
+                             "Sine_Oscillator~ 100 -> *0.5 -> Write_File~ \"" + filename + "\", " + std::to_string(length) + "\n";
+        if (!parser.parse_program(program)) return false;
+
+        for (size_t block = 0; block < length / blocksize; block++) program.run();
+        program.finish();
+
+        // The file takes whole blocks while there's room for them
+        std::vector<float> expected, written(length);
+        if (!render("Sine_Oscillator~ 100 -> *0.5 -> output", blocksize, length - blocksize, expected)) return false;
+        expected.resize(length);
+
+        if (!std::ifstream(filename, std::ios::binary).read(reinterpret_cast<char*>(written.data()), length * sizeof(float))) {
+            message = "The file wasn't written";
+            return false;
+        }
+        return same_samples(written, expected, message);
+    } },
+    { "User_Object_Branch", [] (std::string& message) {
+        Program program;
+        program.configure_io(0, 2);
+        program.reset();
+
+        size_t samples_heard = 0;
+        program.create_user_object("listener", 1, 0, { }, [&samples_heard] (const MultichannelBuffer& input, MultichannelBuffer&, std::any) {
+            for (size_t n = 0; n < input[0].size(); n++) samples_heard += input[0][n] != 0;
+        });
+
+        Parser parser;
+        parser.source_code = "Sine_Oscillator~ 200 -> output\nSine_Oscillator~ 100 -> listener\n";
+        if (!parser.parse_program(program)) return false;
+
+        for (size_t block = 0; block < 4; block++) program.run();
+        if (samples_heard) return true;
+
+        message = "The user object didn't hear anything";
+        return false;
+    } },
+};
+
+// Chains of element-wise objects, and the connections that keep them from being fused, by
+// connecting their members to the second output as well
+const std::vector<std::tuple<std::string, std::string, std::string>> fused_programs = {
+    { "Chain", R"(
+x: Multiply~ 0.5
+y: Add~ 0.25
+z: Tanh~
+Sine_Oscillator~ 100 -> x -> y -> z -> Abs~ -> output
+)", "x -> 1|output\ny -> 1|output\nz -> 1|output\n" },
+    { "Modulated_Chain", R"(
+x: Multiply~
+y: Add~ 0.1
+Sine_Oscillator~ 100 -> x -> y -> output
+Sine_Oscillator~ 3 -> 1|x
+)", "x -> 1|output\n" },
+    { "Feedback", R"(
+m: Multiply~
+a: Add~ 0.1
+Sine_Oscillator~ 100 -> m -> a -> output
+a -> 1|m
+)", "m -> 1|output\n" },
+    { "Feedback_Through_Abs", R"(
+m: Multiply~
+a: Add~ 0.1
+Sine_Oscillator~ 100 -> m -> a -> output
+a -> Abs~ -> 1|m
+)", "m -> 1|output\n" },
+};
+
+static bool fusion_preserves_output(const std::string& source, const std::string& unfusing_connections, std::string& message)
+{
+    std::vector<float> fused, unfused;
+    return render(source, 64, 4096, fused) && render(source + unfusing_connections, 64, 4096, unfused)
+        && same_samples(fused, unfused, message);
+}
+
+// Exports the program to C++, compiles it with a driver writing out a number of blocks of its
+// output, and compares them sample for sample with what the interpreter makes
+static bool export_matches_interpreter(const std::string& source, const size_t blocksize, std::string& message)
+{
+    constexpr size_t blocks = 100;
+
+    Program program;
+    program.set_blocksize(blocksize);
+    program.configure_io(0, 2);
+    program.reset();
+
+    Parser parser;
+    parser.source_code = source;
+    if (!parser.parse_program(program)) return false;
+
+    std::string code;
+    try { code = program.emit_cpp(); }
+    catch (const VolsungException&) { return false; }
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "volsung_export_test";
+    std::filesystem::create_directories(directory);
+    const std::string stem = (directory / "exported").string();
+
+    std::ofstream(stem + ".cc") << code << R"(
+#include <cstdio>
+
+int main()
+{
+    static float left[)" << blocksize << "], right[" << blocksize << R"(];
+    float* out[] = { left, right };
+    for (int block = 0; block < )" << blocks << R"(; block++) {
+        process(nullptr, out, )" << blocksize << R"();
+        std::fwrite(left, sizeof(float), )" << blocksize << R"(, stdout);
+        std::fwrite(right, sizeof(float), )" << blocksize << R"(, stdout);
+    }
+}
+)";
+
+    const std::string command = std::string(VOLSUNG_TEST_COMPILER) + " -std=c++17 -O1 -w " + stem + ".cc -o " + stem
+                                + " && " + stem + " > " + stem + ".raw";
+    if (std::system(command.c_str())) {
+        message = "The exported code failed to compile or run";
+        return false;
+    }
+
+    std::ifstream exported(stem + ".raw", std::ios::binary);
+    for (size_t block = 0; block < blocks; block++) {
+        const MultichannelBuffer output = program.run();
+        for (size_t channel = 0; channel < 2; channel++) {
+            for (size_t n = 0; n < blocksize; n++) {
+                float sample;
+                if (!exported.read(reinterpret_cast<char*>(&sample), sizeof(float))) {
+                    message = "The exported program made too few samples";
+                    return false;
+                }
+
+                const float expected = output[channel][n];
+                if (std::memcmp(&sample, &expected, sizeof(float))) {
+                    message = "Sample " + std::to_string(block * blocksize + n) + " of channel " + std::to_string(channel)
+                            + " is " + std::to_string(sample) + ", not " + std::to_string(expected);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Compares the transforms of a few random signals with a DFT done in double precision
+static bool fft_matches_dft(const size_t size, std::string& message)
+{
+    std::mt19937 generator(size);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    std::vector<Complex> signal(size);
+    for (auto& sample : signal) sample = { distribution(generator), distribution(generator) };
+    std::vector<float> real_signal(size);
+    for (auto& sample : real_signal) sample = distribution(generator);
+
+    constexpr double Tau = 6.28318530717958647692;
+    const auto dft = [size] (auto const& input, const size_t k) {
+        std::complex<double> sum = 0;
+        for (size_t n = 0; n < size; n++)
+            sum += std::complex<double>(input[n]) * std::polar(1.0, -Tau * double(k * n % size) / size);
+        return sum;
+    };
+
+    const auto check = [&message, size] (const std::string& transform, const size_t k, const Complex actual, const std::complex<double> expected) {
+        if (std::abs(std::complex<double>(actual) - expected) <= 1e-6 * size) return true;
+        message = transform + " bin " + std::to_string(k) + " is off by " + std::to_string(std::abs(std::complex<double>(actual) - expected));
+        return false;
+    };
+
+    std::vector<Complex> spectrum = signal;
+    const auto fft = FFT::plan(size);
+    fft->forward(spectrum.data());
+    for (size_t k = 0; k < size; k++)
+        if (!check("Forward", k, spectrum[k], dft(signal, k))) return false;
+
+    fft->inverse(spectrum.data());
+    for (size_t n = 0; n < size; n++)
+        if (!check("Round trip", n, spectrum[n], std::complex<double>(signal[n]) * double(size))) return false;
+
+    if (size % 2) return true;
+
+    std::vector<Complex> real_spectrum(size / 2 + 1);
+    const auto real_fft = RealFFT::plan(size);
+    real_fft->forward(real_signal.data(), real_spectrum.data());
+    for (size_t k = 0; k <= size / 2; k++)
+        if (!check("Real forward", k, real_spectrum[k], dft(real_signal, k))) return false;
+
+    std::vector<float> real_output(size);
+    real_fft->inverse(real_spectrum.data(), real_output.data());
+    for (size_t n = 0; n < size; n++)
+        if (!check("Real round trip", n, real_output[n], double(real_signal[n]) * size)) return false;
+
+    return true;
+}
+
+// Feeds a random signal through a convolution in blocks of varying size, and compares the
+// result with a direct convolution done in double precision
+static bool convolution_matches_direct(const size_t length, std::string& message)
+{
+    std::mt19937 generator(length);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    std::vector<float> impulse_response(length);
+    for (auto& sample : impulse_response) sample = distribution(generator);
+    std::vector<float> signal(4 * length + 1000);
+    for (auto& sample : signal) sample = distribution(generator);
+
+    Convolution convolution(impulse_response);
+    std::vector<float> output(signal.size());
+    const std::vector<size_t> blocksizes = { 1, 37, 64, 200, 513 };
+    for (size_t start = 0, block = 0; start < signal.size(); block++) {
+        const size_t blocksize = std::min(blocksizes[block % blocksizes.size()], signal.size() - start);
+        convolution.process(&signal[start], &output[start], blocksize);
+        start += blocksize;
+    }
+
+    for (size_t n = 0; n < signal.size(); n++) {
+        double expected = 0;
+        for (size_t k = 0; k < length && k <= n; k++)
+            expected += double(impulse_response[k]) * signal[n - k];
+
+        if (std::abs(output[n] - expected) > 1e-6 * length) {
+            message = "Sample " + std::to_string(n) + " is " + std::to_string(output[n]) + ", not " + std::to_string(expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+const size_t num_dots = 30;
+
+// Prints what is being checked, runs the check, and prints whether it passed, with the message
+// it left if it didn't
+static void run_check(const std::string& action, const std::string& name,
+                      const std::function<bool(std::string&)>& check, std::string& message)
+{
+    std::cout << action << " " << name;
+    std::cout << std::flush;
+    for (size_t n = 0; n < num_dots - name.size(); n++)
+        std::cout << ".";
+
+    if (check(message))
+        std::cout << "[" << Ansi_Green << "Pass" << Ansi_Reset << "]";
+    else {
+        std::cout << "[" << Ansi_Red << "Fail" << Ansi_Reset << "] ";
+        std::cout << "\nMessage:\n\t" << message;
+    }
+
+    std::cout << std::endl;
+    message.clear();
+}
+
 int main()
 {
     std::string error_message;
@@ -32,8 +549,6 @@ int main()
         return;
     });
 
-    const size_t num_dots = 30;
-
     for (const auto& file : std::filesystem::directory_iterator(".")) {
         if (file.is_directory()) continue;
         Parser parser;
@@ -80,7 +595,7 @@ int main()
     for (size_t p = 0; p < programs.size(); p++) {
         const auto start_time = chrono::high_resolution_clock::now();
 
-        for (size_t s = 0; s < Volsung::get_sample_rate() / Volsung::AudioBuffer::blocksize; s++) {
+        for (size_t s = 0; s < Volsung::get_sample_rate() / programs[p]->get_blocksize(); s++) {
             programs[p]->run();
         }
 
@@ -96,5 +611,66 @@ int main()
         std::cout << std::endl;
         delete programs[p];
     }
+
+    std::cout << "\n ------ Comparing the FFT with a naive DFT ------ \n";
+
+    for (const size_t size : { 1, 2, 4, 8, 32, 64, 256, 1024, 6, 12, 97, 100, 1000 })
+        run_check("Transforming", std::to_string(size) + " points", [size] (std::string& message) {
+            return fft_matches_dft(size, message);
+        }, error_message);
+
+    std::cout << "\n ------ Comparing convolution with direct convolution ------ \n";
+
+    for (const size_t length : std::initializer_list<size_t> { 1, 50, Convolution::fft_threshold, Convolution::fft_threshold + 1, 1000, 3000 })
+        run_check("Convolving", std::to_string(length) + " samples", [length] (std::string& message) {
+            return convolution_matches_direct(length, message);
+        }, error_message);
+
+    std::cout << "\n ------ Changing copies of sequences ------ \n";
+
+    for (auto const& [name, check] : copy_on_write_checks)
+        run_check("Changing", name, check, error_message);
+
+    std::cout << "\n ------ Simplifying programs ------ \n";
+
+    for (auto const& [name, check] : simplification_checks)
+        run_check("Simplifying", name, check, error_message);
+
+    std::cout << "\n ------ Changing the block size ------ \n";
+
+    for (auto const& [name, source] : exported_programs)
+        for (const size_t blocksize : { 37, 64, 4096 })
+            run_check("Blocking", name + " (" + std::to_string(blocksize) + ")", [&source = source, blocksize] (std::string& message) {
+                return output_ignores_blocksize(source, blocksize, message);
+            }, error_message);
+
+    for (const size_t blocksize : std::initializer_list<size_t> { 0, AudioBuffer::max_blocksize + 1 })
+        run_check("Rejecting", std::to_string(blocksize), [blocksize] (std::string& message) {
+            return rejects_blocksize(blocksize, message);
+        }, error_message);
+
+    std::cout << "\n ------ Echoing through feedback loops ------ \n";
+
+    for (const size_t delay : { 37, 441 })
+        for (const size_t blocksize : { 1, 64, 200 })
+            run_check("Echoing", std::to_string(delay) + " samples (" + std::to_string(blocksize) + ")", [delay, blocksize] (std::string& message) {
+                return echoes_land_on_time(delay, blocksize, message);
+            }, error_message);
+
+    std::cout << "\n ------ Comparing fused chains with their objects run one by one ------ \n";
+
+    for (auto const& [name, source, unfusing_connections] : fused_programs)
+        run_check("Fusing", name, [&source = source, &unfusing_connections = unfusing_connections] (std::string& message) {
+            return fusion_preserves_output(source, unfusing_connections, message);
+        }, error_message);
+
+    std::cout << "\n ------ Comparing exported programs with the interpreter ------ \n";
+
+    for (auto const& [name, source] : exported_programs)
+        for (const size_t blocksize : { 64, 37, 1 })
+            run_check("Exporting", name + " (" + std::to_string(blocksize) + ")", [&source = source, blocksize] (std::string& message) {
+                return export_matches_interpreter(source, blocksize, message);
+            }, error_message);
+
     std::cout << std::endl;
 }